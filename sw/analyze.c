@@ -0,0 +1,296 @@
+#include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+#include "board.h"
+#include "engine.h"
+#include "shared.h"
+#include "timeman.h"
+#include "tt.h"
+
+#define ANALYZE_LINE_MAX (4096)
+// finished results may run ahead of the output by this many positions per worker
+#define ANALYZE_WINDOW_PER_WORKER (4)
+
+typedef struct analyze_result {
+    // input line number (1-based)
+    uint64_t line;
+    // searched, waiting to be written
+    bool done;
+    // normalised FEN; empty if the line wasn't a valid position
+    char fen[ANALYZE_LINE_MAX];
+    gamestate_t gs;
+    best_moves_t moves;
+    int status;
+    uint64_t time_us;
+} analyze_result_t;
+
+typedef struct analyze_job {
+    FILE *in;
+    FILE *out;
+    analyze_params_t params;
+    // guards everything below, and the input and output streams
+    pthread_mutex_t lock;
+    // signalled when the output moves on (freeing a result slot) or the input ends
+    pthread_cond_t cond;
+    bool eof;
+    uint64_t lines_read;
+    // positions are numbered in input order; results[i % window] holds position i
+    uint64_t next_in;
+    uint64_t next_out;
+    analyze_result_t *results;
+    size_t window;
+    uint64_t total_nodes;
+    int errors;
+} analyze_job_t;
+
+// EPD lines have no move counters and may carry operations after the 4 position fields; FEN lines have both counters.
+// writes the position as a FEN to fen and returns 0 if it is valid
+static int parse_position(const char *line, char *fen, board_t *board) {
+    const char *fields[6];
+    size_t lengths[6];
+    int num_fields = 0;
+
+    const char *p = line;
+    while (num_fields < 6) {
+        while (isspace((unsigned char) *p)) ++p;
+        if (!*p) break;
+        fields[num_fields] = p;
+        while (*p && !isspace((unsigned char) *p) && *p != ';') ++p;
+        lengths[num_fields] = p - fields[num_fields];
+        ++num_fields;
+    }
+    if (num_fields < 4) return -1;
+
+    bool has_counters = num_fields == 6;
+    for (int i = 4; i < num_fields; ++i) {
+        for (size_t c = 0; c < lengths[i]; ++c) has_counters &= isdigit((unsigned char) fields[i][c]) != 0;
+    }
+
+    char *out = fen;
+    for (int i = 0; i < (has_counters ? 6 : 4); ++i) {
+        memcpy(out, fields[i], lengths[i]);
+        out += lengths[i];
+        *out++ = ' ';
+    }
+    if (has_counters) {
+        out[-1] = '\0';
+    } else {
+        strcpy(out, "0 1");
+    }
+
+    const char *fen_ptr = fen;
+    if (parse_fen(board, &fen_ptr)) return -1;
+    board->checkmate = 0;
+    return 0;
+}
+
+static void write_result(analyze_job_t *job, const analyze_result_t *result) {
+    FILE *out = job->out;
+    const best_moves_t *moves = &result->moves;
+
+    if (!result->fen[0]) {
+        fprintf(stderr, "line %" PRIu64 ": invalid position\n", result->line);
+        return;
+    }
+
+    char best_move[6] = "0000";
+    bool has_move = !result->status && moves->num_moves > 0;
+    if (has_move) serialize_lan_move(moves->moves[0].move, best_move);
+    int eval = has_move ? moves->moves[0].eval : 0;
+    int mate = mate_moves(eval);
+    bool is_mate = mate != 0;
+
+    // a position without legal moves is over: checkmate scores mate 0 and stalemate 0 cp. the reason tells them (and
+    // failed searches, which have no score) apart from regular results
+    const char *reason = NULL;
+    bool has_score = has_move;
+    if (result->status) {
+        reason = "failed";
+    } else if (!has_move) {
+        const board_t *board = &result->gs.board;
+        int is_b = board->ply & 1;
+        has_score = true;
+        is_mate = is_check(board, (board->kings >> (is_b * 6)) & 0x3F, is_b);
+        reason = is_mate ? "checkmate" : "stalemate";
+    }
+
+    if (job->params.format == ANALYZE_JSONL) {
+        fprintf(out, "{\"line\": %" PRIu64 ", \"fen\": \"%s\", \"bestmove\": \"%s\", ", result->line, result->fen, best_move);
+        if (!has_score) fprintf(out, "\"score\": null, ");
+        else if (is_mate) fprintf(out, "\"score\": {\"mate\": %i}, ", mate);
+        else fprintf(out, "\"score\": {\"cp\": %i}, ", eval);
+        fprintf(out, "\"depth\": %i, \"nodes\": %" PRIu64 ", \"time_ms\": %.3f, \"pv\": [",
+            moves->stats.depth, moves->stats.nodes, result->time_us / 1000.0);
+        for (int i = 0; has_move && i < moves->pv_len; ++i) {
+            char move_name[6];
+            serialize_lan_move(moves->pv[i], move_name);
+            fprintf(out, "%s\"%s\"", i ? ", " : "", move_name);
+        }
+        fprintf(out, "], \"reason\": ");
+        if (reason) fprintf(out, "\"%s\"}\n", reason);
+        else fprintf(out, "null}\n");
+    } else {
+        fprintf(out, "%" PRIu64 ",%s,%s,", result->line, result->fen, best_move);
+        if (has_score && !is_mate) fprintf(out, "%i", eval);
+        fprintf(out, ",");
+        if (is_mate) fprintf(out, "%i", mate);
+        fprintf(out, ",%i,%" PRIu64 ",%.3f,", moves->stats.depth, moves->stats.nodes, result->time_us / 1000.0);
+        for (int i = 0; has_move && i < moves->pv_len; ++i) {
+            char move_name[6];
+            serialize_lan_move(moves->pv[i], move_name);
+            fprintf(out, "%s%s", i ? " " : "", move_name);
+        }
+        fprintf(out, ",%s\n", reason ? reason : "");
+    }
+}
+
+// read the next position into its result slot; returns NULL at the end of the input. called with the lock held
+static analyze_result_t *next_position(analyze_job_t *job) {
+    char line[ANALYZE_LINE_MAX];
+
+    for (;;) {
+        // don't run too far ahead of a slow position that still has to be written
+        while (!job->eof && job->next_in >= job->next_out + job->window) pthread_cond_wait(&job->cond, &job->lock);
+        if (job->eof) return NULL;
+
+        if (!fgets(line, sizeof(line), job->in)) {
+            job->eof = true;
+            pthread_cond_broadcast(&job->cond);
+            return NULL;
+        }
+        ++job->lines_read;
+
+        // overlong lines are dropped (positions are far shorter)
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] != '\n' && !feof(job->in)) {
+            int c;
+            while ((c = fgetc(job->in)) != EOF && c != '\n');
+            line[0] = '\0';
+        }
+
+        // blank lines and comments aren't positions
+        const char *p = line;
+        while (isspace((unsigned char) *p)) ++p;
+        if (!*p || *p == '#') continue;
+
+        analyze_result_t *result = &job->results[job->next_in++ % job->window];
+        result->line = job->lines_read;
+        result->done = false;
+        memset(&result->gs, 0, sizeof(result->gs));
+        if (parse_position(p, result->fen, &result->gs.board)) {
+            result->fen[0] = '\0';
+        } else {
+            gamestate_init(&result->gs);
+        }
+        return result;
+    }
+}
+
+static void *analyze_worker(void *arg) {
+    analyze_job_t *job = arg;
+
+    tt_t tt = {.slots = NULL, .mask = 0};
+    bool has_tt = !tt_resize(&tt, job->params.hash_mb);
+
+    search_params_t search_params = {
+        .timeout_ms = -1,
+        .max_depth = job->params.depth,
+        .max_nodes = job->params.nodes,
+        .threads = 1,
+        .pruning = PRUNE_ALL,
+        .tt = &tt
+    };
+
+    pthread_mutex_lock(&job->lock);
+    analyze_result_t *result;
+    while ((result = next_position(job)) != NULL) {
+        pthread_mutex_unlock(&job->lock);
+
+        result->status = -1;
+        if (result->fen[0] && has_tt) {
+            // every position starts from an empty table, so results don't depend on which worker got it
+            tt_clear(&tt);
+            uint64_t start_us = tm_now_us();
+            result->status = search_moves(&result->gs, search_params, &result->moves);
+            result->time_us = tm_now_us() - start_us;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        result->done = true;
+        if (result->status) ++job->errors;
+        else job->total_nodes += result->moves.stats.nodes;
+
+        // write out everything that is ready, in input order
+        bool advanced = false;
+        analyze_result_t *next;
+        while ((next = &job->results[job->next_out % job->window])->done && job->next_out < job->next_in) {
+            write_result(job, next);
+            next->done = false;
+            ++job->next_out;
+            advanced = true;
+        }
+        if (advanced) {
+            fflush(job->out);
+            pthread_cond_broadcast(&job->cond);
+        }
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    tt_free(&tt);
+    return NULL;
+}
+
+int analyze_start(FILE *in, FILE *out, analyze_params_t params) {
+    if (params.depth < 0 && params.nodes == 0) params.depth = 8;
+    int num_workers = params.workers < 1 ? 1 : params.workers > MAX_THREADS ? MAX_THREADS : params.workers;
+
+    analyze_job_t job = {
+        .in = in,
+        .out = out,
+        .params = params,
+        .eof = false,
+        .lines_read = 0,
+        .next_in = 0,
+        .next_out = 0,
+        .window = (size_t) num_workers * ANALYZE_WINDOW_PER_WORKER,
+        .total_nodes = 0,
+        .errors = 0
+    };
+    job.results = calloc(job.window, sizeof(analyze_result_t));
+    pthread_t *threads = calloc(num_workers, sizeof(pthread_t));
+    if (!job.results || !threads) {
+        free(job.results);
+        free(threads);
+        return -1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    if (params.format == ANALYZE_CSV) fprintf(out, "line,fen,bestmove,score_cp,mate,depth,nodes,time_ms,pv,reason\n");
+
+    // workers run on new threads plus the caller's
+    uint64_t start_us = tm_now_us();
+    int num_started = 1;
+    for (; num_started < num_workers; ++num_started) {
+        if (pthread_create(&threads[num_started], NULL, analyze_worker, &job)) break;
+    }
+    analyze_worker(&job);
+    for (int t = 1; t < num_started; ++t) pthread_join(threads[t], NULL);
+    uint64_t elapsed_us = tm_now_us() - start_us;
+    fflush(out);
+
+    uint64_t positions = job.next_out;
+    fprintf(stderr, "analyzed %" PRIu64 " positions (%i failed) in %.3f s with %i workers: %.1f positions/s, %" PRIu64 " nodes, %" PRIu64 " nps\n",
+        positions, job.errors, elapsed_us / 1e6, num_started, positions * 1e6 / (elapsed_us ? elapsed_us : 1),
+        job.total_nodes, job.total_nodes * 1000000 / (elapsed_us ? elapsed_us : 1));
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.cond);
+    free(job.results);
+    free(threads);
+    return job.errors != 0;
+}
@@ -0,0 +1,55 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+#include "tt.h"
+
+// analyze regression test: positions run through the batch analysis must produce the expected scores, including
+// positions that are already over (meson test 'analyze')
+
+typedef struct analyze_case {
+    const char *name;
+    const char *fen;
+    // expected parts of the position's JSONL result
+    const char *score;
+    const char *reason;
+} analyze_case_t;
+
+static const analyze_case_t analyze_cases[] = {
+    {"mate in 1", "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", "\"bestmove\": \"a1a8\", \"score\": {\"mate\": 1}", "\"reason\": null}"},
+    {"stalemate", "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", "\"bestmove\": \"0000\", \"score\": {\"cp\": 0}", "\"reason\": \"stalemate\"}"},
+    {"checkmate", "7k/6Q1/6K1/8/8/8/8/8 b - - 0 1", "\"bestmove\": \"0000\", \"score\": {\"mate\": 0}", "\"reason\": \"checkmate\"}"},
+};
+
+int main() {
+    int failures = 0;
+    int num_cases = sizeof(analyze_cases) / sizeof(analyze_cases[0]);
+    analyze_params_t params = {.depth = 4, .nodes = 0, .workers = 1, .hash_mb = TT_DEFAULT_MB, .format = ANALYZE_JSONL};
+
+    for (int i = 0; i < num_cases; ++i) {
+        const analyze_case_t *c = &analyze_cases[i];
+        char *result = NULL;
+        size_t result_size = 0;
+        FILE *in = fmemopen((void *) c->fen, strlen(c->fen), "r");
+        FILE *out = open_memstream(&result, &result_size);
+        if (!in || !out || analyze_start(in, out, params)) {
+            printf("FAIL %-10s analysis failed\n", c->name);
+            ++failures;
+        } else {
+            fclose(out);
+            out = NULL;
+            bool ok = strstr(result, c->score) && strstr(result, c->reason);
+            failures += !ok;
+            printf("%s %-10s %s", ok ? "ok  " : "FAIL", c->name, result);
+        }
+
+        if (in) fclose(in);
+        if (out) fclose(out);
+        free(result);
+    }
+
+    printf("%i/%i passed\n", num_cases - failures, num_cases);
+    return failures != 0;
+}
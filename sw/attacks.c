@@ -0,0 +1,146 @@
+#include <stdbool.h>
+
+#include "attacks.h"
+#include "bitops.h"
+#include "tables.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define HAS_PEXT_BACKEND 1
+#else
+#define HAS_PEXT_BACKEND 0
+#endif
+
+const char *attack_backend_names[NB_ATTACK_BACKENDS] = {
+    [ATTACKS_HQ] = "hq",
+    [ATTACKS_MAGIC] = "magic",
+    [ATTACKS_PEXT] = "pext"
+};
+
+static attack_backend_t backend = ATTACKS_HQ;
+
+static uint64_t rook_attacks_hq(uint64_t occ, int src) {
+    uint64_t rank_atk = ((uint64_t) rank_attacks[((occ >> (src & 0x38)) >> 1) & 0x3F][src & 0x07]) << (src & 0x38);
+
+    uint64_t other_occ = occ & ~(1ull << src);
+    uint64_t file_mask = 0x0101010101010101ull << (src & 0x07);
+    uint64_t up_atk = (other_occ & file_mask) - (1ull << src);
+    // uint64_t down_atk = BS64(occ & file_mask) - ((0x1000000000000000ull >> (src & 0x38)) << 1);
+    uint64_t down_atk = BS64(other_occ & file_mask) - BS64(1ull << src);
+
+    // return ((up_atk ^ down_atk) & file_mask) | rank_atk;
+    return ((up_atk ^ BS64(down_atk)) & file_mask) | rank_atk;
+}
+
+static uint64_t bishop_attacks_hq(uint64_t occ, int src) {
+    uint64_t other_occ = occ & ~(1ull << src);
+    int diag = (src >> 3) + (src & 0x07);
+    int antidiag = (src >> 3) + 7 - (src & 0x07);
+
+    uint64_t diag_mask = diags[diag];
+    uint64_t antidiag_mask = antidiags[antidiag];
+
+    uint64_t nw_atk = (other_occ & diag_mask) - (1ull << src);
+    uint64_t se_atk = BS64(other_occ & diag_mask) - BS64(1ull << src);
+
+    uint64_t ne_atk = (other_occ & antidiag_mask) - (1ull << src);
+    uint64_t sw_atk = BS64(other_occ & antidiag_mask) - BS64(1ull << src);
+
+    return ((nw_atk ^ BS64(se_atk)) & diag_mask) | ((ne_atk ^ BS64(sw_atk)) & antidiag_mask);
+}
+
+static uint64_t rook_attacks_magic(uint64_t occ, int src) {
+    const magic_t *m = &rook_magics[src];
+    return m->attacks[((occ & m->mask) * m->magic) >> m->shift];
+}
+
+static uint64_t bishop_attacks_magic(uint64_t occ, int src) {
+    const magic_t *m = &bishop_magics[src];
+    return m->attacks[((occ & m->mask) * m->magic) >> m->shift];
+}
+
+#if HAS_PEXT_BACKEND
+__attribute__((target("bmi2"))) static uint64_t rook_attacks_pext(uint64_t occ, int src) {
+    const magic_t *m = &rook_magics[src];
+    return m->pext_attacks[_pext_u64(occ, m->mask)];
+}
+
+__attribute__((target("bmi2"))) static uint64_t bishop_attacks_pext(uint64_t occ, int src) {
+    const magic_t *m = &bishop_magics[src];
+    return m->pext_attacks[_pext_u64(occ, m->mask)];
+}
+#endif
+
+uint64_t (*rook_attacks)(uint64_t occ, int src) = rook_attacks_hq;
+uint64_t (*bishop_attacks)(uint64_t occ, int src) = bishop_attacks_hq;
+
+#if HAS_PEXT_BACKEND
+// PEXT is microcoded (slower than magics) on AMD before Zen 3 (family 19h)
+static bool pext_is_slow() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return true;
+    // vendor string "AuthenticAMD" in ebx, edx, ecx
+    bool is_amd = ebx == 0x68747541 && edx == 0x69746e65 && ecx == 0x444d4163;
+    if (!is_amd) return false;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return true;
+    unsigned int family = (eax >> 8) & 0x0F;
+    if (family == 0x0F) family += (eax >> 20) & 0xFF;
+    return family < 0x19;
+}
+#endif
+
+// the tables are built in (see gen_tables.c); this only picks the fastest backend the CPU supports, before main() runs
+__attribute__((constructor)) static void attacks_init() {
+#if HAS_PEXT_BACKEND
+    if (!pext_is_slow() && !attacks_select(ATTACKS_PEXT)) return;
+#endif
+    attacks_select(ATTACKS_MAGIC);
+}
+
+bool attacks_supported(attack_backend_t b) {
+    switch (b) {
+        case ATTACKS_HQ:
+        case ATTACKS_MAGIC:
+            return true;
+        case ATTACKS_PEXT:
+#if HAS_PEXT_BACKEND
+            return __builtin_cpu_supports("bmi2");
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+int attacks_select(attack_backend_t b) {
+    if (!attacks_supported(b)) return -1;
+
+    switch (b) {
+        case ATTACKS_HQ:
+            rook_attacks = rook_attacks_hq;
+            bishop_attacks = bishop_attacks_hq;
+            break;
+        case ATTACKS_MAGIC:
+            rook_attacks = rook_attacks_magic;
+            bishop_attacks = bishop_attacks_magic;
+            break;
+#if HAS_PEXT_BACKEND
+        case ATTACKS_PEXT:
+            rook_attacks = rook_attacks_pext;
+            bishop_attacks = bishop_attacks_pext;
+            break;
+#endif
+        default:
+            return -1;
+    }
+
+    backend = b;
+    return 0;
+}
+
+attack_backend_t attacks_selected() {
+    return backend;
+}
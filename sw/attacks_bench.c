@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "attacks.h"
+#include "bench.h"
+#include "bench_util.h"
+#include "engine.h"
+
+// compares the slider attack backends on occupancies/squares taken from real positions
+
+#define MAX_SAMPLES (1 << 20)
+#define MIN_TIME_US (100000)
+
+static slider_sample_t rook_samples[MAX_SAMPLES];
+static slider_sample_t bishop_samples[MAX_SAMPLES];
+static slider_samples_t samples = {.rook = rook_samples, .bishop = bishop_samples, .max = MAX_SAMPLES};
+
+static bool collect(gamestate_t *gs, void *ctx) {
+    (void) ctx;
+    bench_sample_sliders(&samples, &gs->board);
+    return true;
+}
+
+typedef struct attack_run {
+    uint64_t (**fn)(uint64_t, int);
+    const slider_sample_t *samples;
+    int num_samples;
+    // sum of the attack sets of one pass, compared between backends
+    uint64_t checksum;
+} attack_run_t;
+
+static uint64_t run(void *ctx) {
+    attack_run_t *r = ctx;
+    uint64_t sum = 0;
+    for (int i = 0; i < r->num_samples; ++i) sum += (*r->fn)(r->samples[i].occ, r->samples[i].sq);
+    r->checksum = sum;
+    return r->num_samples;
+}
+
+static double time_attacks(uint64_t (**fn)(uint64_t, int), const slider_sample_t *s, int num_samples, uint64_t *checksum) {
+    attack_run_t r = {.fn = fn, .samples = s, .num_samples = num_samples};
+    uint64_t calls;
+    double elapsed_ns = bench_time(run, &r, MIN_TIME_US, &calls);
+    *checksum = r.checksum;
+    return calls ? elapsed_ns / calls : 0.0;
+}
+
+int main(int argc, char **argv) {
+    int depth = argc > 1 ? atoi(argv[1]) : 2;
+
+    for (int i = 0; i < num_bench_fens; ++i) {
+        gamestate_t gs;
+        if (bench_position(&gs, i)) return 1;
+        bench_walk(&gs, depth, collect, NULL);
+    }
+
+    attack_backend_t initial = attacks_selected();
+    printf("%i rook samples, %i bishop samples (default backend: %s)\n", samples.num_rook, samples.num_bishop, attack_backend_names[initial]);
+    printf("%-8s %12s %12s\n", "backend", "rook ns", "bishop ns");
+
+    uint64_t ref_rook = 0, ref_bishop = 0;
+    int status = 0;
+    for (attack_backend_t b = 0; b < NB_ATTACK_BACKENDS; ++b) {
+        if (attacks_select(b)) {
+            printf("%-8s %12s %12s\n", attack_backend_names[b], "-", "-");
+            continue;
+        }
+
+        uint64_t rook_sum, bishop_sum;
+        double rook_ns = time_attacks(&rook_attacks, samples.rook, samples.num_rook, &rook_sum);
+        double bishop_ns = time_attacks(&bishop_attacks, samples.bishop, samples.num_bishop, &bishop_sum);
+        printf("%-8s %12.2f %12.2f\n", attack_backend_names[b], rook_ns, bishop_ns);
+
+        if (b == ATTACKS_HQ) {
+            ref_rook = rook_sum;
+            ref_bishop = bishop_sum;
+        } else if (rook_sum != ref_rook || bishop_sum != ref_bishop) {
+            printf("  mismatch against %s!\n", attack_backend_names[ATTACKS_HQ]);
+            status = 1;
+        }
+    }
+
+    attacks_select(initial);
+    return status;
+}
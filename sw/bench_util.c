@@ -0,0 +1,48 @@
+#include <string.h>
+
+#include "bench.h"
+#include "bench_util.h"
+#include "bitops.h"
+#include "shared.h"
+#include "timeman.h"
+
+int bench_position(gamestate_t *gs, int index) {
+    memset(gs, 0, sizeof(*gs));
+    const char *fen = bench_fens[index];
+    if (parse_fen(&gs->board, &fen)) return -1;
+    gamestate_init(gs);
+    return 0;
+}
+
+void bench_walk(gamestate_t *gs, int depth, bool (*visit)(gamestate_t *gs, void *ctx), void *ctx) {
+    if (!visit(gs, ctx) || depth <= 0) return;
+
+    move_t moves[MAX_MOVES];
+    undo_t undo;
+    int num_moves = legal_moves(gs, moves);
+    for (int i = 0; i < num_moves; ++i) {
+        make_move(gs, moves[i], &undo);
+        bench_walk(gs, depth - 1, visit, ctx);
+        unmake_move(gs, moves[i], &undo);
+    }
+}
+
+void bench_sample_sliders(slider_samples_t *samples, const board_t *board) {
+    uint64_t occ = occupancy(board);
+    for (uint64_t rooks = board->pieces[ROOK] | board->pieces[QUEEN]; rooks && samples->num_rook < samples->max; rooks &= rooks - 1) {
+        samples->rook[samples->num_rook++] = (slider_sample_t) {.occ = occ, .sq = CTZ64(rooks)};
+    }
+    for (uint64_t bishops = board->pieces[BISHOP] | board->pieces[QUEEN]; bishops && samples->num_bishop < samples->max; bishops &= bishops - 1) {
+        samples->bishop[samples->num_bishop++] = (slider_sample_t) {.occ = occ, .sq = CTZ64(bishops)};
+    }
+}
+
+double bench_time(uint64_t (*run)(void *ctx), void *ctx, uint64_t min_us, uint64_t *calls) {
+    uint64_t start_us = tm_now_us();
+    uint64_t elapsed_us;
+    *calls = 0;
+    do {
+        *calls += run(ctx);
+    } while ((elapsed_us = tm_now_us() - start_us) < min_us);
+    return elapsed_us * 1e3;
+}
@@ -1,144 +1,106 @@
 #include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include "attacks.h"
+#include "bitops.h"
 #include "board.h"
 #include "engine.h"
+#include "pst.h"
 #include "shared.h"
-
-#ifndef __has_builtin
-#define __has_builtin(x) (0)
-#endif
-
-#if __has_builtin(__builtin_ctzll) && __has_builtin(__builtin_bswap64) && __has_builtin(__builtin_popcountll)
-#define CTZ64 __builtin_ctzll
-#define CTZ32 __builtin_ctz
-#define CLZ64 __builtin_clzll
-#define CLZ32 __builtin_clz
-#define BS64 __builtin_bswap64
-#define BS32 __builtin_bswap32
-#define POPCNT32 __builtin_popcount
-#define POPCNT64 __builtin_popcountll
-#else
-#error Unsupported compiler
-#endif
+#include "tables.h"
+#include "timeman.h"
+#include "tt.h"
 
 void update_white(gamestate_t *gamestate, uint64_t move_mask) {
     gamestate->board.pieces_w = (gamestate->board.ply & 1) ? (gamestate->board.pieces_w & ~move_mask) : (gamestate->board.pieces_w | move_mask);
 }
 
-bool do_capture(gamestate_t *gamestate, uint8_t dst) {
-    int did_capture = 0;
-
+// returns the captured piece type (KING if a king was taken) or -1 if nothing was captured
+int do_capture(gamestate_t *gamestate, uint8_t dst) {
     for (int i = 0; i < NB_PIECES; ++i) {
-        did_capture |= (gamestate->board.pieces[i] >> dst) & 1;
-        gamestate->board.pieces[i] &= ~(1ull << dst);
+        if ((gamestate->board.pieces[i] >> dst) & 1) {
+            gamestate->board.pieces[i] &= ~(1ull << dst);
+            return i;
+        }
     }
 
-    for (int i = 0; i < 2; ++i) {
-        int update = dst == ((gamestate->board.kings >> (i * 6)) & 0x3F);
-        did_capture |= update;
-        gamestate->board.checkmate |= update << i;
+    int kings = gamestate->board.kings;
+    int checkmate = (dst == (kings & 0x3F)) | ((dst == (kings >> 6)) << 1);
+    if (checkmate) {
+        gamestate->board.checkmate |= checkmate;
+        return KING;
     }
 
-    return (bool) did_capture;
+    return -1;
 }
 
-static int init = 0;
-static uint64_t king_moves[64] = {0};
-static uint64_t knight_moves[64] = {0};
-static uint8_t rank_attacks[64][8] = {0};
-static uint64_t diags[15] = {0};
-static uint64_t antidiags[15] = {0};
-
-void static_init() {
-    if (!init) {
-        for (int i = 0; i < 64; ++i) {
-            uint64_t move = (1ull << i) | ((1ull << i) << 8) | ((1ull << i) >> 8);
-            uint64_t side_moves = (move >> ((i & 7) != 0)) | (move << ((i & 7) != 7));
-
-            king_moves[i] = (move | side_moves) & ~(1ull << i);
-        }
-
-        for (int i = 0; i < 64; ++i) {
-            uint64_t move = 0;
-            for (int xl = 0; xl < 4; ++xl) {
-                int x = (i & 7) - 2 + xl + (xl >> 1);
-                int sdy = (xl & 1) ^ (xl >> 1);
-                for (int yl = 0; yl < 2; ++yl) {
-                    int y = (i / 8) - (1 << sdy) + (yl << (sdy + 1));
-                    if (x >= 0 && x < 8 && y >= 0 && y < 8) {
-                        move |= 1ull << (y * 8 + x);
-                    }
-                }
-            }
-            knight_moves[i] = move;
-        }
-
-        for (int occ = 0; occ < 64; ++occ) {
-            for (int f = 0; f < 8; ++f) {
-                int mask_lo = (1 << f) - 1;
-                int mask_hi = -(2 << f);
-
-                int lo = 31 - CLZ32(((occ << 1) & mask_lo) | 1);
-                int hi = CTZ32(((occ << 1) & mask_hi) | 128);
-
-                rank_attacks[occ][f] = (2 << hi) - (1 << lo);
-            }
-        }
-
-        for (int diag = 0; diag < 15; ++diag) {
-            for (int rank = 0; rank < 8; ++rank) {
-                int file = diag - rank;
-                diags[diag] |= 0 <= file && file < 8 ? (1ull << (rank * 8 + file)) : 0;
-                antidiags[diag] |= 0 <= file && file < 8 ? (1ull << (rank * 8 + 7 - file)) : 0;
-            }
-        }
+#define FILE_A (0x0101010101010101ull)
+#define FILE_H (0x8080808080808080ull)
+#define RANK_1 (0x00000000000000FFull)
+#define RANK_3 (0x0000000000FF0000ull)
+#define RANK_6 (0x0000FF0000000000ull)
+#define RANK_8 (0xFF00000000000000ull)
 
-        init = 1;
-    }
+static inline void psq_add(gamestate_t *gamestate, int is_b, int piece, int sq) {
+    gamestate->psq[0] += psq_table[is_b][piece][sq][0];
+    gamestate->psq[1] += psq_table[is_b][piece][sq][1];
 }
 
-uint64_t rook_attacks(uint64_t occ, int src) {
-    uint64_t rank_atk = ((uint64_t) rank_attacks[((occ >> (src & 0x38)) >> 1) & 0x3F][src & 0x07]) << (src & 0x38);
+static inline void psq_sub(gamestate_t *gamestate, int is_b, int piece, int sq) {
+    gamestate->psq[0] -= psq_table[is_b][piece][sq][0];
+    gamestate->psq[1] -= psq_table[is_b][piece][sq][1];
+}
 
-    uint64_t other_occ = occ & ~(1ull << src);
-    uint64_t file_mask = 0x0101010101010101ull << (src & 0x07);
-    uint64_t up_atk = (other_occ & file_mask) - (1ull << src);
-    // uint64_t down_atk = BS64(occ & file_mask) - ((0x1000000000000000ull >> (src & 0x38)) << 1);
-    uint64_t down_atk = BS64(other_occ & file_mask) - BS64(1ull << src);
+uint64_t occupancy(const board_t *board) {
+    uint64_t occupied = (1ull << (board->kings & 0x3F)) | (1ull << ((board->kings >> 6) & 0x3F));
+    for (int i = 0; i < NB_PIECES; ++i) occupied |= board->pieces[i];
 
-    // return ((up_atk ^ down_atk) & file_mask) | rank_atk;
-    return ((up_atk ^ BS64(down_atk)) & file_mask) | rank_atk;
+    return occupied;
 }
 
-uint64_t bishop_attacks(uint64_t occ, int src) {
-    uint64_t other_occ = occ & ~(1ull << src);
-    int diag = (src >> 3) + (src & 0x07);
-    int antidiag = (src >> 3) + 7 - (src & 0x07);
+static inline uint64_t shift(uint64_t b, int delta) {
+    return delta > 0 ? b << delta : b >> -delta;
+}
 
-    uint64_t diag_mask = diags[diag];
-    uint64_t antidiag_mask = antidiags[antidiag];
+// pawn moves to each of dsts from dst - delta; moves to the last rank are expanded into all promotions
+static inline int add_pawn_shift(move_t *moves, int m, uint64_t dsts, int delta) {
+    uint64_t promotions = dsts & (RANK_1 | RANK_8);
 
-    uint64_t nw_atk = (other_occ & diag_mask) - (1ull << src);
-    uint64_t se_atk = BS64(other_occ & diag_mask) - BS64(1ull << src);
+    for (dsts &= ~promotions; dsts != 0; dsts &= dsts - 1) {
+        int dst = CTZ64(dsts);
+        moves[m] = move_new(dst - delta, dst, SPECIAL_NONE);
+        ++m;
+    }
 
-    uint64_t ne_atk = (other_occ & antidiag_mask) - (1ull << src);
-    uint64_t sw_atk = BS64(other_occ & antidiag_mask) - BS64(1ull << src);
+    for (; promotions != 0; promotions &= promotions - 1) {
+        int dst = CTZ64(promotions);
+        for (int promo = SPECIAL_PROMOTE_QUEEN; promo >= SPECIAL_PROMOTE_KNIGHT; --promo, ++m) {
+            moves[m] = move_new(dst - delta, dst, promo);
+        }
+    }
 
-    return ((nw_atk ^ BS64(se_atk)) & diag_mask) | ((ne_atk ^ BS64(sw_atk)) & antidiag_mask);
+    return m;
 }
 
-uint64_t occupancy(const board_t *board) {
-    uint64_t occupied = (1ull << (board->kings & 0x3F)) | (1ull << ((board->kings >> 6) & 0x3F));
-    for (int i = 0; i < NB_PIECES; ++i) occupied |= board->pieces[i];
-
-    return occupied;
+// pushes and captures of all the given pawns at once, each kind of move being one shift of the pawn set;
+// destinations outside mask are dropped. en passant is left to the caller
+static inline int add_pawn_sets(move_t *moves, int m, uint64_t pawns, int is_b, uint64_t empty, uint64_t enemies, uint64_t mask) {
+    int fwd = is_b ? -8 : 8;
+    uint64_t push = shift(pawns, fwd) & empty;
+    uint64_t double_push = shift(push & (is_b ? RANK_6 : RANK_3), fwd) & empty;
+    uint64_t capture_west = shift(pawns & ~FILE_A, fwd - 1) & enemies;
+    uint64_t capture_east = shift(pawns & ~FILE_H, fwd + 1) & enemies;
+
+    m = add_pawn_shift(moves, m, capture_west & mask, fwd - 1);
+    m = add_pawn_shift(moves, m, capture_east & mask, fwd + 1);
+    m = add_pawn_shift(moves, m, push & mask, fwd);
+    return add_pawn_shift(moves, m, double_push & mask, 2 * fwd);
 }
 
 int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
-    static_init();
     int is_b = gamestate->board.ply & 1;
     uint64_t color = is_b ? ~gamestate->board.pieces_w : gamestate->board.pieces_w;
 
@@ -155,9 +117,7 @@ int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
         while (king_legal != 0) {
             int sq = CTZ64(king_legal);
 
-            moves[m].src = king_pos;
-            moves[m].dst = sq;
-            moves[m].special = SPECIAL_NONE;
+            moves[m] = move_new(king_pos, sq, SPECIAL_NONE);
             ++m;
 
             king_legal ^= 1ull << sq;
@@ -166,16 +126,12 @@ int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
         int castle_rights = (gamestate->board.castle >> (is_b * 2)) & 0x3;
 
         if ((castle_rights & 1) && ((occupied >> (is_b * 0x38)) & 0x60) == 0) {
-            moves[m].src = king_pos;
-            moves[m].dst = (king_pos & 0x38) | (0x6);
-            moves[m].special = SPECIAL_CASTLE;
+            moves[m] = move_new(king_pos, (king_pos & 0x38) | (0x6), SPECIAL_CASTLE);
             ++m;
         }
 
-        if ((castle_rights & 2) && ((occupied >> (is_b * 0x38)) & 0x0D) == 0) {
-            moves[m].src = king_pos;
-            moves[m].dst = (king_pos & 0x38) | (0x2);
-            moves[m].special = SPECIAL_CASTLE;
+        if ((castle_rights & 2) && ((occupied >> (is_b * 0x38)) & 0x0E) == 0) {
+            moves[m] = move_new(king_pos, (king_pos & 0x38) | (0x2), SPECIAL_CASTLE);
             ++m;     
         }
     }
@@ -190,9 +146,7 @@ int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
             while (all_dst != 0) {
                 int sq = CTZ64(all_dst);
 
-                moves[m].src = src;
-                moves[m].dst = sq;
-                moves[m].special = SPECIAL_NONE;
+                moves[m] = move_new(src, sq, SPECIAL_NONE);
                 ++m;
 
                 all_dst ^= 1ull << sq;
@@ -205,65 +159,15 @@ int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
     {
         // pawn moves
         uint64_t pawns = gamestate->board.pieces[PAWN] & color;
+        m = add_pawn_sets(moves, m, pawns, is_b, ~occupied, enemies, ~0ull);
 
-        // TODO: parallelize with bitmasking
-        while (pawns != 0) {
-            int src = CTZ64(pawns);
-            int cap = (8 - is_b * 16);
-            int can_promote = 7 - ((src + cap) >> 3) == is_b * 7;
-            int can_double = ((src - cap) >> 3) == is_b * 7;
-            int is_ep_rank = (src >> 3) == (4 - is_b);
-            int m_initial = m;
-
-            // can assume forward is always in bounds; otherwise invalid board
-            if (((occupied >> (src + cap)) & 1ull) == 0) {
-                moves[m].src = src;
-                moves[m].dst = src + cap;
-                moves[m].special = SPECIAL_NONE;
+        if (gamestate->board.en_passant & 8) {
+            int ep_dst = (is_b ? 0x10 : 0x28) | (gamestate->board.en_passant & 7);
+            // the pawns attacking the en passant square are those an enemy pawn there would attack
+            for (uint64_t srcs = pawn_attacks[!is_b][ep_dst] & pawns; srcs != 0; srcs &= srcs - 1) {
+                moves[m] = move_new(CTZ64(srcs), ep_dst, SPECIAL_EN_PASSANT);
                 ++m;
-
-                if (can_double && ((occupied >> (src + 2 * cap)) & 1ull) == 0) {
-                    moves[m].src = src;
-                    moves[m].dst = src + 2 * cap;
-                    moves[m].special = SPECIAL_NONE;
-                    ++m;
-                }
             }
-
-            if ((src & 7) != 0) {
-                int is_capture = (enemies >> (src + cap - 1)) & 1;
-
-                if (is_capture || (is_ep_rank && ((gamestate->board.en_passant & 8) != 0 && (gamestate->board.en_passant & 7) == (src & 7) - 1))) {
-                    moves[m].src = src;
-                    moves[m].dst = src + cap - 1;
-                    moves[m].special = is_capture ? SPECIAL_NONE : SPECIAL_EN_PASSANT;
-                    ++m;
-                }
-            }
-
-            if ((src & 7) != 7) {
-                int is_capture = (enemies >> (src + cap + 1)) & 1;
-
-                if (is_capture || (is_ep_rank && ((gamestate->board.en_passant & 8) != 0 && (gamestate->board.en_passant & 7) == (src & 7) + 1))) {
-                    moves[m].src = src;
-                    moves[m].dst = src + cap + 1;
-                    moves[m].special = is_capture ? SPECIAL_NONE : SPECIAL_EN_PASSANT;
-                    ++m;
-                }
-            }
-
-            if (can_promote) {
-                for (int m_final = m; m_initial < m_final; ++m_initial) {
-                    moves[m_initial].special = SPECIAL_PROMOTE_QUEEN;
-                    for (int promo = SPECIAL_PROMOTE_KNIGHT; promo < SPECIAL_PROMOTE_QUEEN; ++promo, ++m) {
-                        moves[m].src = moves[m_initial].src;
-                        moves[m].dst = moves[m_initial].dst;
-                        moves[m].special = promo;
-                    }
-                }
-            }
-
-            pawns ^= 1ull << src;
         }
     }
 
@@ -277,9 +181,7 @@ int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
             while (atk != 0) {
                 int dst = CTZ64(atk);
 
-                moves[m].src = src;
-                moves[m].dst = dst;
-                moves[m].special = SPECIAL_NONE;
+                moves[m] = move_new(src, dst, SPECIAL_NONE);
                 ++m;
 
                 atk ^= 1ull << dst;
@@ -299,9 +201,7 @@ int pseudolegal_moves(const gamestate_t *gamestate, move_t* moves) {
             while (atk != 0) {
                 int dst = CTZ64(atk);
 
-                moves[m].src = src;
-                moves[m].dst = dst;
-                moves[m].special = SPECIAL_NONE;
+                moves[m] = move_new(src, dst, SPECIAL_NONE);
                 ++m;
 
                 atk ^= 1ull << dst;
@@ -332,51 +232,231 @@ int is_check(const board_t *board, int king, int is_b) {
 }
 
 int is_legal(gamestate_t *gamestate, move_t last_move) {
-    static_init();
     int was_b = (gamestate->board.ply & 1) ^ 1;
     int king_pos = (gamestate->board.kings >> (was_b * 6)) & 0x3F;
 
     return (gamestate->board.checkmate >> (was_b ^ 1)) || (!is_check(&gamestate->board, king_pos, was_b) && (
-        last_move.special != SPECIAL_CASTLE ||
+        move_special(last_move) != SPECIAL_CASTLE ||
         // disallow castling out of check or through check
         // note: the fact the board state isn't quite the same (rook in wrong spot) is OK for our current design
-        (!is_check(&gamestate->board, last_move.src, was_b) && !is_check(&gamestate->board, ((king_pos & 0x38) | (last_move.dst < last_move.src ? 0x03 : 0x05)), was_b))
+        (!is_check(&gamestate->board, move_src(last_move), was_b) && !is_check(&gamestate->board, ((king_pos & 0x38) | (move_dst(last_move) < move_src(last_move) ? 0x03 : 0x05)), was_b))
     ));
 }
 
-int execute_move(gamestate_t *gamestate, move_t move) {
+// all pieces (either color, kings included) attacking a square with the given occupancy
+static uint64_t attackers_to(const board_t *board, int sq, uint64_t occ) {
+    uint64_t kings = (1ull << (board->kings & 0x3F)) | (1ull << (board->kings >> 6));
+
+    return (king_moves[sq] & kings) | (knight_moves[sq] & board->pieces[KNIGHT]) |
+        (rook_attacks(occ, sq) & (board->pieces[ROOK] | board->pieces[QUEEN])) |
+        (bishop_attacks(occ, sq) & (board->pieces[BISHOP] | board->pieces[QUEEN])) |
+        (pawn_attacks[0][sq] & board->pieces[PAWN] & ~board->pieces_w) |
+        (pawn_attacks[1][sq] & board->pieces[PAWN] & board->pieces_w);
+}
+
+static inline int add_moves(move_t *moves, int m, int src, uint64_t targets) {
+    while (targets != 0) {
+        int dst = CTZ64(targets);
+
+        moves[m] = move_new(src, dst, SPECIAL_NONE);
+        ++m;
+
+        targets &= targets - 1;
+    }
+
+    return m;
+}
+
+// fully legal moves; returns the number of moves written
+int legal_moves(const gamestate_t *gamestate, move_t* moves) {
+    const board_t *board = &gamestate->board;
+    int is_b = board->ply & 1;
+    uint64_t color = is_b ? ~board->pieces_w : board->pieces_w;
+
+    uint64_t occupied = occupancy(board);
+    uint64_t allies = occupied & color;
+    uint64_t enemies = occupied & ~color;
+    int king = (board->kings >> (is_b * 6)) & 0x3F;
+
+    uint64_t checkers = attackers_to(board, king, occupied) & enemies;
+
+    // enemy sliders that would attack the king if our own pieces were removed
+    uint64_t snipers = ((rook_attacks(enemies, king) & (board->pieces[ROOK] | board->pieces[QUEEN])) |
+        (bishop_attacks(enemies, king) & (board->pieces[BISHOP] | board->pieces[QUEEN]))) & enemies;
+    uint64_t pinned = 0;
+    while (snipers != 0) {
+        int sq = CTZ64(snipers);
+        uint64_t blockers = between[king][sq] & occupied;
+        if ((blockers & (blockers - 1)) == 0) pinned |= blockers & allies;
+        snipers &= snipers - 1;
+    }
+
+    int m = 0;
+
+    {
+        // king moves; the king itself can't block attacks on the squares it moves to, and a captured piece doesn't attack
+        uint64_t king_legal = king_moves[king] & ~allies;
+        uint64_t occ_no_king = occupied & ~(1ull << king);
+        while (king_legal != 0) {
+            int sq = CTZ64(king_legal);
+            if ((attackers_to(board, sq, occ_no_king) & enemies & ~(1ull << sq)) == 0) m = add_moves(moves, m, king, 1ull << sq);
+            king_legal &= king_legal - 1;
+        }
+
+        int castle_rights = (board->castle >> (is_b * 2)) & 0x3;
+
+        if (checkers == 0 && (castle_rights & 1) && ((occupied >> (is_b * 0x38)) & 0x60) == 0 &&
+            !is_check(board, king + 1, is_b) && !is_check(board, king + 2, is_b)) {
+            moves[m] = move_new(king, king + 2, SPECIAL_CASTLE);
+            ++m;
+        }
+
+        if (checkers == 0 && (castle_rights & 2) && ((occupied >> (is_b * 0x38)) & 0x0E) == 0 &&
+            !is_check(board, king - 1, is_b) && !is_check(board, king - 2, is_b)) {
+            moves[m] = move_new(king, king - 2, SPECIAL_CASTLE);
+            ++m;
+        }
+    }
+
+    // in double check only the king can move
+    if (checkers & (checkers - 1)) return m;
+
+    // with a single checker, other pieces must capture it or block
+    uint64_t target_mask = checkers ? checkers | between[king][CTZ64(checkers)] : ~0ull;
+    uint64_t targets = ~allies & target_mask;
+
+    {
+        // knight moves; a pinned knight can never move
+        uint64_t knights = board->pieces[KNIGHT] & allies & ~pinned;
+        while (knights != 0) {
+            int src = CTZ64(knights);
+            m = add_moves(moves, m, src, knight_moves[src] & targets);
+            knights &= knights - 1;
+        }
+    }
+
+    {
+        // rook + queen moves
+        uint64_t rooks = (board->pieces[ROOK] | board->pieces[QUEEN]) & allies;
+        while (rooks != 0) {
+            int src = CTZ64(rooks);
+            uint64_t atk = rook_attacks(occupied, src) & targets;
+            if ((pinned >> src) & 1) atk &= line[king][src];
+            m = add_moves(moves, m, src, atk);
+            rooks &= rooks - 1;
+        }
+    }
+
+    {
+        // bishop + queen moves
+        uint64_t bishops = (board->pieces[BISHOP] | board->pieces[QUEEN]) & allies;
+        while (bishops != 0) {
+            int src = CTZ64(bishops);
+            uint64_t atk = bishop_attacks(occupied, src) & targets;
+            if ((pinned >> src) & 1) atk &= line[king][src];
+            m = add_moves(moves, m, src, atk);
+            bishops &= bishops - 1;
+        }
+    }
+
+    {
+        // pawn moves; unpinned pawns all at once, pinned ones (rare) one by one along their pin line
+        uint64_t pawns = board->pieces[PAWN] & allies;
+        m = add_pawn_sets(moves, m, pawns & ~pinned, is_b, ~occupied, enemies, target_mask);
+
+        for (uint64_t pinned_pawns = pawns & pinned; pinned_pawns != 0; pinned_pawns &= pinned_pawns - 1) {
+            int src = CTZ64(pinned_pawns);
+            m = add_pawn_sets(moves, m, 1ull << src, is_b, ~occupied, enemies, target_mask & line[king][src]);
+        }
+
+        if (board->en_passant & 8) {
+            int ep_dst = (is_b ? 0x10 : 0x28) | (board->en_passant & 7);
+            int ep_victim = ep_dst - (8 - is_b * 16);
+
+            for (uint64_t srcs = pawn_attacks[!is_b][ep_dst] & pawns; srcs != 0; srcs &= srcs - 1) {
+                int src = CTZ64(srcs);
+                // en passant removes two pieces from the same rank, so verify directly against the resulting occupancy
+                uint64_t ep_occ = (occupied ^ (1ull << src) ^ (1ull << ep_victim)) | (1ull << ep_dst);
+                if ((attackers_to(board, king, ep_occ) & enemies & ~(1ull << ep_victim)) == 0) {
+                    moves[m] = move_new(src, ep_dst, SPECIAL_EN_PASSANT);
+                    ++m;
+                }
+            }
+        }
+    }
+
+    return m;
+}
+
+// castling rights lost when a piece moves from or to a square (i.e. a rook moving or being captured)
+static int corner_rights(int sq) {
+    int rights = ((sq & 7) == 7) | (((sq & 7) == 0) << 1);
+    return (sq >> 3) == 0 ? rights : (sq >> 3) == 7 ? rights << 2 : 0;
+}
+
+int make_move(gamestate_t *gamestate, move_t move, undo_t *undo) {
     bool is_b = gamestate->board.ply & 1;
     int king = ((gamestate->board.kings >> (is_b * 6)) & 0x3F);
-
-    if (move.src == king) {
+    // flags are rehashed once the move is done
+    uint64_t hash = gamestate->hash ^ zobrist_flags(&gamestate->board) ^ zobrist_black;
+
+    gamestate->history[gamestate->board.ply & (HASH_HISTORY - 1)] = gamestate->hash;
+    undo->hash = gamestate->hash;
+    undo->pawn_hash = gamestate->pawn_hash;
+    undo->pieces_w = gamestate->board.pieces_w;
+    undo->checkmate = gamestate->board.checkmate;
+    undo->en_passant = gamestate->board.en_passant;
+    undo->castle = gamestate->board.castle;
+    undo->ply50 = gamestate->board.ply50;
+    undo->psq[0] = gamestate->psq[0];
+    undo->psq[1] = gamestate->psq[1];
+    undo->phase = gamestate->phase;
+
+    if (move_src(move) == king) {
         gamestate->board.en_passant = 0;
-        update_white(gamestate, 1ull << move.dst);
-        bool captured = do_capture(gamestate, move.dst);
+        update_white(gamestate, 1ull << move_dst(move));
+        int captured = do_capture(gamestate, move_dst(move));
+        if (captured >= 0 && captured < NB_PIECES) {
+            hash ^= zobrist_pieces[!is_b][captured][move_dst(move)];
+            if (captured == PAWN) gamestate->pawn_hash ^= zobrist_pieces[!is_b][PAWN][move_dst(move)];
+            psq_sub(gamestate, !is_b, captured, move_dst(move));
+            gamestate->phase -= pst_phase_weights[captured];
+        }
 
-        gamestate->board.kings = (gamestate->board.kings & ~(0x3F << (is_b * 6))) | (move.dst << (is_b * 6));
-        gamestate->board.castle &= ~(0x3 << (is_b * 2));
-        gamestate->board.ply50 = captured ? 0 : +gamestate->board.ply50 + 1;
+        gamestate->board.kings = (gamestate->board.kings & ~(0x3F << (is_b * 6))) | (move_dst(move) << (is_b * 6));
+        hash ^= zobrist_pieces[is_b][KING][move_src(move)] ^ zobrist_pieces[is_b][KING][move_dst(move)];
+        gamestate->board.castle &= ~((0x3 << (is_b * 2)) | corner_rights(move_dst(move)));
+        gamestate->board.ply50 = captured >= 0 ? 0 : +gamestate->board.ply50 + 1;
 
-        int dx = (int) (move.dst & 7) - (int) (move.src & 7);
+        int dx = (int) (move_dst(move) & 7) - (int) (move_src(move) & 7);
 
         if (gamestate->engine_debug) {
             // TODO: verify move legality
         }
 
-        if (move.special == SPECIAL_CASTLE || (move.special == SPECIAL_UNKNOWN && (dx > 1 || dx < -1))) {
-            uint8_t rook_src = (move.src & 56) | (move.dst < move.src ? 0 : 7);
-            uint8_t rook_dst = (move.src & 56) | (move.dst < move.src ? 3 : 5);
+        undo->piece = KING;
+        undo->captured = captured;
+        undo->special = SPECIAL_NONE;
+
+        if (move_special(move) == SPECIAL_CASTLE || (move_special(move) == SPECIAL_UNKNOWN && (dx > 1 || dx < -1))) {
+            uint8_t rook_src = (move_src(move) & 56) | (move_dst(move) < move_src(move) ? 0 : 7);
+            uint8_t rook_dst = (move_src(move) & 56) | (move_dst(move) < move_src(move) ? 3 : 5);
             gamestate->board.pieces[ROOK] = (gamestate->board.pieces[ROOK] & ~(1ull << rook_src)) | (1ull << rook_dst);
             update_white(gamestate, 1ull << rook_dst);
+            hash ^= zobrist_pieces[is_b][ROOK][rook_src] ^ zobrist_pieces[is_b][ROOK][rook_dst];
+            psq_sub(gamestate, is_b, ROOK, rook_src);
+            psq_add(gamestate, is_b, ROOK, rook_dst);
+            undo->special = SPECIAL_CASTLE;
         }
 
         ++gamestate->board.ply;
-        return (int) captured;
+        gamestate->hash = hash ^ zobrist_flags(&gamestate->board);
+        return (int) (captured >= 0);
     }
 
     int piece_type = -1;
     for (int i = 0; i < NB_PIECES; ++i) {
-        if (gamestate->board.pieces[i] & (1ull << move.src)) piece_type = i;
+        if (gamestate->board.pieces[i] & (1ull << move_src(move))) piece_type = i;
     }
     // piece_type should only be updated once; todo verify
 
@@ -386,162 +466,268 @@ int execute_move(gamestate_t *gamestate, move_t move) {
         // TODO: verify move legality
     }
 
-    update_white(gamestate, 1ull << move.dst);
-    bool did_capture = do_capture(gamestate, move.dst);
+    update_white(gamestate, 1ull << move_dst(move));
+    int captured = do_capture(gamestate, move_dst(move));
+    bool did_capture = captured >= 0;
+    if (did_capture && captured < NB_PIECES) {
+        hash ^= zobrist_pieces[!is_b][captured][move_dst(move)];
+        if (captured == PAWN) gamestate->pawn_hash ^= zobrist_pieces[!is_b][PAWN][move_dst(move)];
+        psq_sub(gamestate, !is_b, captured, move_dst(move));
+        gamestate->phase -= pst_phase_weights[captured];
+    }
+
+    undo->piece = piece_type;
+    undo->captured = captured;
+    undo->special = SPECIAL_NONE;
 
     ++gamestate->board.ply;
     gamestate->board.ply50 = did_capture || piece_type == PAWN ? 0 : gamestate->board.ply50 + 1;
-    gamestate->board.en_passant = (move.dst & 7) | ((piece_type == PAWN && abs(move.dst - move.src) == 16) << 3);
-    gamestate->board.castle &= ~(((piece_type == ROOK && (move.src >> 3) == (7 * is_b)) ? ((move.src & 0x07) == 0 || (move.src & 0x07) == 7) + ((move.src & 0x07) == 0) : 0) << (2 * is_b));
+    gamestate->board.en_passant = (move_dst(move) & 7) | ((piece_type == PAWN && abs(move_dst(move) - move_src(move)) == 16) << 3);
+    gamestate->board.castle &= ~(corner_rights(move_src(move)) | corner_rights(move_dst(move)));
+    if (piece_type == PAWN) gamestate->pawn_hash ^= zobrist_pieces[is_b][PAWN][move_src(move)];
 
-    if (move.special & SPECIAL_PROMOTE) {
+    if (move_special(move) & SPECIAL_PROMOTE) {
         // requires piece_type == PAWN; todo verify
-        gamestate->board.pieces[piece_type] &= ~(1ull << move.src);
-        gamestate->board.pieces[move.special & ~SPECIAL_PROMOTE] |= (1ull << move.dst);
+        gamestate->board.pieces[piece_type] &= ~(1ull << move_src(move));
+        gamestate->board.pieces[move_special(move) & ~SPECIAL_PROMOTE] |= (1ull << move_dst(move));
+        gamestate->hash = hash ^ zobrist_flags(&gamestate->board) ^
+            zobrist_pieces[is_b][piece_type][move_src(move)] ^ zobrist_pieces[is_b][move_special(move) & ~SPECIAL_PROMOTE][move_dst(move)];
+        psq_sub(gamestate, is_b, piece_type, move_src(move));
+        psq_add(gamestate, is_b, move_special(move) & ~SPECIAL_PROMOTE, move_dst(move));
+        gamestate->phase += pst_phase_weights[move_special(move) & ~SPECIAL_PROMOTE] - pst_phase_weights[piece_type];
+        undo->special = move_special(move);
         return 0;
     }
 
-    gamestate->board.pieces[piece_type] = (gamestate->board.pieces[piece_type] & ~(1ull << move.src)) | (1ull << move.dst);
-    if (move.special == SPECIAL_EN_PASSANT || (move.special == SPECIAL_UNKNOWN && piece_type == PAWN && (move.dst & 7) != (move.src & 7) && !did_capture)) {
+    gamestate->board.pieces[piece_type] = (gamestate->board.pieces[piece_type] & ~(1ull << move_src(move))) | (1ull << move_dst(move));
+    hash ^= zobrist_pieces[is_b][piece_type][move_src(move)] ^ zobrist_pieces[is_b][piece_type][move_dst(move)];
+    psq_sub(gamestate, is_b, piece_type, move_src(move));
+    psq_add(gamestate, is_b, piece_type, move_dst(move));
+    if (piece_type == PAWN) gamestate->pawn_hash ^= zobrist_pieces[is_b][PAWN][move_dst(move)];
+    if (move_special(move) == SPECIAL_EN_PASSANT || (move_special(move) == SPECIAL_UNKNOWN && piece_type == PAWN && (move_dst(move) & 7) != (move_src(move) & 7) && !did_capture)) {
         // should always return true; todo verify
-        do_capture(gamestate, is_b ? ((move.dst + 8) & 63) : ((move.dst - 8) & 63));
+        int ep_sq = is_b ? ((move_dst(move) + 8) & 63) : ((move_dst(move) - 8) & 63);
+        do_capture(gamestate, ep_sq);
+        gamestate->hash = hash ^ zobrist_flags(&gamestate->board) ^ zobrist_pieces[!is_b][PAWN][ep_sq];
+        gamestate->pawn_hash ^= zobrist_pieces[!is_b][PAWN][ep_sq];
+        psq_sub(gamestate, !is_b, PAWN, ep_sq);
+        gamestate->phase -= pst_phase_weights[PAWN];
+        undo->special = SPECIAL_EN_PASSANT;
+        undo->captured = PAWN;
         return 1;
     }
 
+    gamestate->hash = hash ^ zobrist_flags(&gamestate->board);
     return (int) did_capture;
 }
 
-#define MAX_STACK (64)
+void unmake_move(gamestate_t *gamestate, move_t move, const undo_t *undo) {
+    --gamestate->board.ply;
+    bool is_b = gamestate->board.ply & 1;
 
-int pawn_eval[64] = {
-      0,   0,   0,   0,   0,   0,   0,   0,
-      5,  10,  10, -20, -20,  10,  10,   5,
-      5,  -5, -10,   0,   0, -10,  -5,   5,
-      0,   0,   0,  20,  20,   0,   0,   0,
-      5,   5,  10,  25,  25,  10,   5,   5,
-     10,  10,  20,  30,  30,  20,  10,  10,
-     50,  50,  50,  50,  50,  50,  50,  50,
-      0,   0,   0,   0,   0,   0,   0,   0,
-};
+    gamestate->hash = undo->hash;
+    gamestate->pawn_hash = undo->pawn_hash;
+    gamestate->board.pieces_w = undo->pieces_w;
+    gamestate->board.checkmate = undo->checkmate;
+    gamestate->board.en_passant = undo->en_passant;
+    gamestate->board.castle = undo->castle;
+    gamestate->board.ply50 = undo->ply50;
+    gamestate->psq[0] = undo->psq[0];
+    gamestate->psq[1] = undo->psq[1];
+    gamestate->phase = undo->phase;
+
+    if (undo->piece == KING) {
+        gamestate->board.kings = (gamestate->board.kings & ~(0x3F << (is_b * 6))) | (move_src(move) << (is_b * 6));
+
+        if (undo->special == SPECIAL_CASTLE) {
+            uint8_t rook_src = (move_src(move) & 56) | (move_dst(move) < move_src(move) ? 0 : 7);
+            uint8_t rook_dst = (move_src(move) & 56) | (move_dst(move) < move_src(move) ? 3 : 5);
+            gamestate->board.pieces[ROOK] = (gamestate->board.pieces[ROOK] & ~(1ull << rook_dst)) | (1ull << rook_src);
+        }
+    } else if (undo->special & SPECIAL_PROMOTE) {
+        gamestate->board.pieces[undo->special & ~SPECIAL_PROMOTE] &= ~(1ull << move_dst(move));
+        gamestate->board.pieces[PAWN] |= 1ull << move_src(move);
+    } else {
+        gamestate->board.pieces[undo->piece] = (gamestate->board.pieces[undo->piece] & ~(1ull << move_dst(move))) | (1ull << move_src(move));
+    }
 
-int king_eval[64] = {
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -30, -40, -40, -50, -50, -40, -40, -30,
-    -20, -30, -30, -40, -40, -30, -30, -20,
-    -10, -20, -20, -20, -20, -20, -20, -10,
-     20,  20,   0,   0,   0,   0,  20,  20,
-     20,  30,  10,   0,   0,  10,  30,  20,
-};
+    // captured kings are only flagged in checkmate, which was restored above
+    if (undo->captured >= 0 && undo->captured < NB_PIECES) {
+        int cap_sq = undo->special == SPECIAL_EN_PASSANT ? (is_b ? move_dst(move) + 8 : move_dst(move) - 8) : move_dst(move);
+        gamestate->board.pieces[undo->captured] |= 1ull << cap_sq;
+    }
+}
 
-int king_eval_endgame[64] = {
-    -50, -40, -30, -20, -20, -30, -40, -50,
-    -30, -20, -10,   0,   0, -10, -20, -30,
-    -30, -10,  20,  30,  30,  20, -10, -30,
-    -30, -10,  30,  40,  40,  30, -10, -30,
-    -30, -10,  30,  40,  40,  30, -10, -30,
-    -30, -10,  20,  30,  30,  20, -10, -30,
-    -30, -30,   0,   0,   0,   0, -30, -30,
-    -50, -30, -30, -30, -30, -30, -30, -50,
-};
+// pass the turn (for null move pruning)
+static void make_null_move(gamestate_t *gamestate, undo_t *undo) {
+    gamestate->history[gamestate->board.ply & (HASH_HISTORY - 1)] = gamestate->hash;
+    undo->hash = gamestate->hash;
+    undo->en_passant = gamestate->board.en_passant;
+    undo->ply50 = gamestate->board.ply50;
+
+    uint64_t hash = gamestate->hash ^ zobrist_flags(&gamestate->board) ^ zobrist_black;
+    gamestate->board.en_passant = 0;
+    // positions before a null move can't repeat after it
+    gamestate->board.ply50 = 0;
+    ++gamestate->board.ply;
+    gamestate->hash = hash ^ zobrist_flags(&gamestate->board);
+}
 
-int knight_eval[64] = {
-    -50, -40, -30, -30, -30, -30, -40, -50,
-    -40, -20,   0,   0,   0,   0, -20, -40,
-    -30,   0,  10,  15,  15,  10,   0, -30,
-    -30,   5,  15,  20,  20,  15,   5, -30,
-    -30,   0,  15,  20,  20,  15,   0, -30,
-    -30,   5,  10,  15,  15,  10,   5, -30,
-    -40, -20,   0,   5,   5,   0, -20, -40,
-    -50, -40, -30, -30, -30, -30, -40, -50,
-};
+static void unmake_null_move(gamestate_t *gamestate, const undo_t *undo) {
+    --gamestate->board.ply;
+    gamestate->hash = undo->hash;
+    gamestate->board.en_passant = undo->en_passant;
+    gamestate->board.ply50 = undo->ply50;
+}
 
-int bishop_eval[64] = {
-    -20, -10, -10, -10, -10, -10, -10, -20,
-    -10,   0,   0,   0,   0,   0,   0, -10,
-    -10,   0,   5,  10,  10,   5,   0, -10,
-    -10,   5,   5,  10,  10,   5,   5, -10,
-    -10,   0,  10,  10,  10,  10,   0, -10,
-    -10,  10,  10,  10,  10,  10,  10, -10,
-    -10,   5,   0,   0,   0,   0,   5, -10,
-    -20, -10, -10, -10, -10, -10, -10, -20,
-};
+int execute_move(gamestate_t *gamestate, move_t move) {
+    undo_t undo;
+    return make_move(gamestate, move, &undo);
+}
 
-int rook_eval[64] = {
-     0,  0,  0,  0,  0,  0,  0,  0,
-     5, 10, 10, 10, 10, 10, 10,  5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-    -5,  0,  0,  0,  0,  0,  0, -5,
-     0,  0,  0,  5,  5,  0,  0,  0,
-};
+// full material + piece-square recomputation; make_move() keeps this up to date incrementally
+static void psq_full(const board_t *board, int32_t *psq, int16_t *phase) {
+    psq[0] = psq[1] = 0;
+    *phase = 0;
 
-int queen_eval[64] = {
-    -20, -10, -10,  -5,  -5, -10, -10, -20,
-    -10,   0,   0,   0,   0,   0,   0, -10,
-    -10,   0,   5,   5,   5,   5,   0, -10,
-     -5,   0,   5,   5,   5,   5,   0,  -5,
-      0,   0,   5,   5,   5,   5,   0,  -5,
-    -10,   5,   5,   5,   5,   5,   0, -10,
-    -10,   0,   5,   0,   0,   0,   0, -10,
-    -20, -10, -10,  -5,  -5, -10, -10, -20,
-};
+    for (piece_t p = 0; p < NB_PIECES; ++p) {
+        for (uint64_t locs = board->pieces[p]; locs != 0; locs &= locs - 1) {
+            int sq = CTZ64(locs);
+            int is_b = ((board->pieces_w >> sq) & 1) ^ 1;
+            psq[0] += psq_table[is_b][p][sq][0];
+            psq[1] += psq_table[is_b][p][sq][1];
+            *phase += pst_phase_weights[p];
+        }
+    }
+}
 
+void gamestate_init(gamestate_t *gamestate) {
+    gamestate->hash = zobrist_hash(&gamestate->board);
+    gamestate->pawn_hash = zobrist_pawn_hash(&gamestate->board);
+    psq_full(&gamestate->board, gamestate->psq, &gamestate->phase);
+    // moves before this position are unknown
+    memset(gamestate->history, 0, sizeof(gamestate->history));
+}
 
-int piece_weights[NB_ALL_PIECES] = {
-    [KNIGHT] = 300,
-    [BISHOP] = 340,
-    [ROOK] = 550,
-    [QUEEN] = 1000,
-    [PAWN] = 100,
-    [KING] = 15000
-};
+#define MAX_STACK (64)
+#define MAX_QUIESCE (10)
+// deepest ply from the root the search can reach (full depth plus quiescence)
+#define MAX_PLY (MAX_STACK + MAX_QUIESCE + 2)
 
-int* piece_locs[NB_ALL_PIECES][2] = {
-    [KNIGHT] = {knight_eval, knight_eval},
-    [BISHOP] = {bishop_eval, bishop_eval},
-    [ROOK] = {rook_eval, rook_eval},
-    [QUEEN] = {queen_eval, queen_eval},
-    [PAWN] = {pawn_eval, pawn_eval},
-    [KING] = {king_eval, king_eval_endgame},
-};
+static inline uint64_t north_fill(uint64_t b) {
+    b |= b << 8;
+    b |= b << 16;
+    return b | (b << 32);
+}
 
-int static_eval(const gamestate_t *gamestate) {
-    int eval = 0;
+static inline uint64_t south_fill(uint64_t b) {
+    b |= b >> 8;
+    b |= b >> 16;
+    return b | (b >> 32);
+}
 
-    // material + positional advantage
-    int is_endgame = POPCNT64(gamestate->board.pieces[QUEEN]) * 9 + POPCNT64(gamestate->board.pieces[ROOK]) * 5 +
-        POPCNT64(gamestate->board.pieces[KNIGHT]) * 3 + POPCNT64(gamestate->board.pieces[BISHOP]) * 3 +
-        POPCNT64(gamestate->board.pieces[PAWN]) <= 26;
+// both neighbouring squares on the same rank
+static inline uint64_t sides(uint64_t b) {
+    return ((b << 1) & ~FILE_A) | ((b >> 1) & ~FILE_H);
+}
 
-    int mat = 0;
-    for (piece_t p = KNIGHT; p < NB_PIECES; ++p) {
-        uint64_t locs = gamestate->board.pieces[p];
+// pawn structure score by [is_endgame] of the own pawns, with both sides' pawns seen from the own side (moving north)
+static void pawn_terms(uint64_t own, uint64_t enemy, int32_t *score) {
+    uint64_t behind = south_fill(own) >> 8;
+    uint64_t files = south_fill(north_fill(own));
+    uint64_t enemy_front = south_fill(enemy) >> 8;
 
-        while (locs != 0) {
-            int src = CTZ64(locs);
-            int is_w = (gamestate->board.pieces_w >> src) & 1;
+    // the rear pawn of a doubled pair is neither passed nor counted twice
+    uint64_t doubled = own & behind;
+    uint64_t isolated = own & ~sides(files);
+    uint64_t passed = own & ~(enemy_front | sides(enemy_front)) & ~behind;
+    // stop squares attacked by enemy pawns that no own pawn can ever defend by advancing
+    uint64_t backward = (((own << 8) & sides(enemy >> 8) & ~north_fill(sides(own << 8))) >> 8) & ~isolated;
 
-            if (is_w) {
-                mat += piece_weights[p] + piece_locs[p][is_endgame][src];
-            } else {
-                mat -= piece_weights[p] + piece_locs[p][is_endgame][0x38 - (src & 0x38) + (src & 0x07)];
-            }
+    for (int i = 0; i < 2; ++i) {
+        score[i] += POPCNT64(doubled) * pst_doubled_pawn[i] + POPCNT64(isolated) * pst_isolated_pawn[i] +
+            POPCNT64(backward) * pst_backward_pawn[i];
+    }
+    for (; passed != 0; passed &= passed - 1) {
+        int rank = CTZ64(passed) >> 3;
+        score[0] += pst_passed_pawn[0][rank];
+        score[1] += pst_passed_pawn[1][rank];
+    }
+}
+
+// pawn structure score by [is_endgame] from white's view; black's pawns are mirrored so both sides are scored alike
+static void pawn_eval(const board_t *board, int32_t *score) {
+    uint64_t white = board->pieces[PAWN] & board->pieces_w;
+    uint64_t black = board->pieces[PAWN] & ~board->pieces_w;
+    int32_t score_w[2] = {0, 0};
+    int32_t score_b[2] = {0, 0};
+    pawn_terms(white, black, score_w);
+    pawn_terms(BS64(black), BS64(white), score_b);
+    score[0] = score_w[0] - score_b[0];
+    score[1] = score_w[1] - score_b[1];
+}
+
+// entries of each search thread's pawn hash table (power of 2)
+#define PAWN_TABLE_SIZE (8192)
+
+// pawn structure score for a pawn hash; the structure changes on few moves, so most lookups hit.
+// an empty entry (key 0, score 0) is correct for a board without pawns
+typedef struct pawn_entry {
+    uint64_t key;
+    int16_t score[2];
+} pawn_entry_t;
+
+// evaluation from white's view; the pawn structure score is cached in pawn_table if given (stats counts the lookups)
+static int evaluate(const gamestate_t *gamestate, pawn_entry_t *pawn_table, search_stats_t *stats) {
+#ifdef RIVER_CHECK_EVAL
+    int32_t full_psq[2];
+    int16_t full_phase;
+    psq_full(&gamestate->board, full_psq, &full_phase);
+    assert(full_psq[0] == gamestate->psq[0] && full_psq[1] == gamestate->psq[1] && full_phase == gamestate->phase);
+    assert(gamestate->pawn_hash == zobrist_pawn_hash(&gamestate->board));
+#endif
 
-            locs ^= 1ull << src;
+    int eval = 0;
+    // material + positional advantage, blended between the midgame and endgame tables by phase
+    int mg = gamestate->psq[0];
+    int eg = gamestate->psq[1];
+    int king_w = gamestate->board.kings & 0x3F;
+    int king_b = (gamestate->board.kings >> 6) ^ 0x38;
+
+    int32_t pawns[2];
+    if (pawn_table) {
+        pawn_entry_t *entry = &pawn_table[gamestate->pawn_hash & (PAWN_TABLE_SIZE - 1)];
+        ++stats->pawn_probes;
+        if (entry->key == gamestate->pawn_hash) {
+            ++stats->pawn_hits;
+        } else {
+            pawn_eval(&gamestate->board, pawns);
+            entry->key = gamestate->pawn_hash;
+            entry->score[0] = pawns[0];
+            entry->score[1] = pawns[1];
         }
+        mg += entry->score[0];
+        eg += entry->score[1];
+    } else {
+        pawn_eval(&gamestate->board, pawns);
+        mg += pawns[0];
+        eg += pawns[1];
     }
 
-    if (!(gamestate->board.checkmate & 1)) mat += piece_weights[KING] + piece_locs[KING][is_endgame][gamestate->board.kings & 0x3F];
-    if (!(gamestate->board.checkmate >> 1)) mat -= piece_weights[KING] + piece_locs[KING][is_endgame][gamestate->board.kings >> 6];
-    eval += mat;
+    if (!(gamestate->board.checkmate & 1)) {
+        mg += pst_piece_values[KING] + pst_mg[KING][king_w];
+        eg += pst_piece_values[KING] + pst_eg[KING][king_w];
+    }
+    if (!(gamestate->board.checkmate >> 1)) {
+        mg -= pst_piece_values[KING] + pst_mg[KING][king_b];
+        eg -= pst_piece_values[KING] + pst_eg[KING][king_b];
+    }
+    int phase = gamestate->phase < PST_PHASE_EG ? 0 : gamestate->phase > PST_PHASE_MG ? PST_PHASE_MG - PST_PHASE_EG : gamestate->phase - PST_PHASE_EG;
+    eval += (mg * phase + eg * (PST_PHASE_MG - PST_PHASE_EG - phase)) / (PST_PHASE_MG - PST_PHASE_EG);
 
     // bishop pair advantage
-    int dark_bishop = gamestate->board.pieces[BISHOP] & 0xCC55CC55CC55CC55ull;
-    int light_bishop = gamestate->board.pieces[BISHOP] & 0x55CC55CC55CC55CCull;
+    uint64_t dark_bishop = gamestate->board.pieces[BISHOP] & 0xAA55AA55AA55AA55ull;
+    uint64_t light_bishop = gamestate->board.pieces[BISHOP] & 0x55AA55AA55AA55AAull;
     int bishop_pair_delta = ((dark_bishop & gamestate->board.pieces_w) != 0 && (light_bishop & gamestate->board.pieces_w) != 0) - 
         ((dark_bishop & ~gamestate->board.pieces_w) != 0 && (light_bishop & ~gamestate->board.pieces_w) != 0);
     int bishop_pair_bonus = 80 * bishop_pair_delta;
@@ -550,168 +736,925 @@ int static_eval(const gamestate_t *gamestate) {
     return eval;
 }
 
-uint64_t perft(const gamestate_t *gamestate, int depth) {
+int static_eval(const gamestate_t *gamestate) {
+    return evaluate(gamestate, NULL, NULL);
+}
+
+// memoised subtree counts; key holds (hash ^ depth key) ^ count so torn slots read as a miss
+typedef struct perft_slot {
+    _Atomic uint64_t key;
+    _Atomic uint64_t count;
+} perft_slot_t;
+
+typedef struct perft_table {
+    perft_slot_t *slots;
+    uint64_t mask;
+} perft_table_t;
+
+static uint64_t perft_key(uint64_t hash, int depth) {
+    return hash ^ ((uint64_t) depth * 0x9E3779B97F4A7C15ull);
+}
+
+static uint64_t perft_inplace(gamestate_t *gamestate, int depth, perft_table_t *table) {
     if (depth <= 0) return 1;
 
-    move_t pl_moves[MAX_MOVES];
-    gamestate_t gs_next;
+    move_t moves[MAX_MOVES];
+    undo_t undo;
+
+    int num_moves = legal_moves(gamestate, moves);
+    if (depth == 1) return num_moves;
+
+    // bulk counting makes depth 1 cheaper than a lookup
+    perft_slot_t *slot = NULL;
+    uint64_t key = 0;
+    if (table) {
+        key = perft_key(gamestate->hash, depth);
+        slot = &table->slots[key & table->mask];
+        uint64_t count = atomic_load_explicit(&slot->count, memory_order_relaxed);
+        if ((atomic_load_explicit(&slot->key, memory_order_relaxed) ^ count) == key) return count;
+    }
 
-    int num_moves = pseudolegal_moves(gamestate, pl_moves);
     uint64_t children = 0;
 
     for (int i = 0; i < num_moves; ++i) {
-        memcpy(&gs_next, gamestate, sizeof(gamestate_t));
-        assert(execute_move(&gs_next, pl_moves[i]) >= 0);
+        int move_exec = make_move(gamestate, moves[i], &undo);
+        assert(move_exec >= 0);
+
+        children += perft_inplace(gamestate, depth - 1, table);
+        unmake_move(gamestate, moves[i], &undo);
+    }
 
-        if (!is_legal(&gs_next, pl_moves[i])) continue;
-        children += perft(&gs_next, depth - 1);
+    if (slot) {
+        atomic_store_explicit(&slot->key, key ^ children, memory_order_relaxed);
+        atomic_store_explicit(&slot->count, children, memory_order_relaxed);
     }
 
     return children;
 }
 
+uint64_t perft(const gamestate_t *gamestate, int depth) {
+    gamestate_t gs = *gamestate;
+    return perft_inplace(&gs, depth, NULL);
+}
+
+struct perft_job {
+    const gamestate_t *root;
+    int depth;
+    perft_table_t *table;
+    perft_divide_t *divide;
+    // next root move to claim
+    atomic_int next;
+};
+
+static void *perft_worker(void *arg) {
+    struct perft_job *job = arg;
+    gamestate_t gs = *job->root;
+    undo_t undo;
+
+    // root moves are claimed one at a time so uneven subtrees balance out
+    int i;
+    while ((i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->divide->num_moves) {
+        int move_exec = make_move(&gs, job->divide->moves[i], &undo);
+        assert(move_exec >= 0);
+
+        job->divide->counts[i] = perft_inplace(&gs, job->depth - 1, job->table);
+        unmake_move(&gs, job->divide->moves[i], &undo);
+    }
+
+    return NULL;
+}
+
+uint64_t perft_divide(const gamestate_t *gamestate, int depth, perft_params_t params, perft_divide_t *divide) {
+    perft_divide_t local_divide;
+    if (!divide) divide = &local_divide;
+
+    divide->num_moves = 0;
+    if (depth <= 0) return 1;
+
+    divide->num_moves = legal_moves(gamestate, divide->moves);
+    if (depth == 1) {
+        for (int i = 0; i < divide->num_moves; ++i) divide->counts[i] = 1;
+        return divide->num_moves;
+    }
+
+    perft_table_t table = {.slots = NULL, .mask = 0};
+    if (params.hash_mb > 0) {
+        uint64_t num_slots = 1;
+        while (num_slots * 2 * sizeof(perft_slot_t) <= (uint64_t) params.hash_mb << 20) num_slots *= 2;
+        table.slots = calloc(num_slots, sizeof(perft_slot_t));
+        table.mask = num_slots - 1;
+    }
+
+    struct perft_job job = {
+        .root = gamestate,
+        .depth = depth,
+        .table = table.slots ? &table : NULL,
+        .divide = divide,
+        .next = 0
+    };
+
+    int num_threads = params.threads < 1 ? 1 : params.threads > MAX_THREADS ? MAX_THREADS : params.threads;
+    if (num_threads > divide->num_moves) num_threads = divide->num_moves;
+
+    // workers run on new threads plus the caller's; if a thread fails to start the others pick up its moves
+    pthread_t threads[MAX_THREADS];
+    int num_started = 1;
+    for (; num_started < num_threads; ++num_started) {
+        if (pthread_create(&threads[num_started], NULL, perft_worker, &job)) break;
+    }
+    perft_worker(&job);
+    for (int t = 1; t < num_started; ++t) pthread_join(threads[t], NULL);
+
+    free(table.slots);
+
+    uint64_t total = 0;
+    for (int i = 0; i < divide->num_moves; ++i) total += divide->counts[i];
+    return total;
+}
+
 struct search_state {
-    struct timeval start_time;
-    uint64_t timeout_us;
+    // shared by all threads of a search; the main thread sets it when time runs out or it is done
+    atomic_bool *stop;
+    // only the main thread watches the clock
+    bool is_main;
+    time_manager_t tm;
+    // searching before ponderhit (main thread only)
+    bool pondering;
+    search_params_t params;
+    // each thread walks its own copy of the root position
+    gamestate_t gs;
+    // first iteration depth; helper threads are staggered so they don't all search the same tree
+    int start_depth;
+    // board ply at the root; negamax() ply from the root is board ply - root_ply
+    int root_ply;
+    // quiet moves that caused a beta cutoff, per ply from the root (newest first)
+    move_t killers[MAX_STACK][2];
+    // butterfly history of quiet cutoffs, indexed by [is_b][src][dst]; aged between iterations
+    int history[2][64][64];
+    // pawn structure scores by pawn hash; each thread keeps its own
+    pawn_entry_t pawns[PAWN_TABLE_SIZE];
+    search_stats_t stats;
+    // shared by all threads of a search
+    tt_t *tt;
+    // node count of all threads; each adds its own every TM_CHECK_NODES nodes
+    _Atomic uint64_t *nodes;
+    // deepest ply from the root reached this iteration
+    int seldepth;
+    // move lists and their ordering scores by ply from the root, so search frames don't each hold their own
+    move_t moves[MAX_PLY][MAX_MOVES];
+    int scores[MAX_PLY][MAX_MOVES];
+    // triangular PV table: pv[ply] holds the best line from ply on, pv_len[ply] moves long
+    move_t pv[MAX_PLY][MAX_PLY];
+    int pv_len[MAX_PLY];
+    // last iteration this thread completed (-1 if none)
+    int completed_depth;
+    best_moves_t result;
+    // info output (main thread only): search start, last line written, and a completed iteration not yet reported
+    uint64_t start_us;
+    uint64_t info_us;
+    bool info_pending;
 };
 
-int timed_out(const struct search_state *st) {
-    struct timeval cur;
-    gettimeofday(&cur, NULL);
-    return (cur.tv_sec - st->start_time.tv_sec) * 1000000 + (cur.tv_usec - st->start_time.tv_usec) >= st->timeout_us;
+static bool should_stop(struct search_state *st) {
+    return atomic_load_explicit(st->stop, memory_order_relaxed);
 }
 
-int sort_moves(void* data, const void* a, const void* b) {
-    move_t l = *((move_t*) a);
-    move_t r = *((move_t*) b);
-    board_t* board = (board_t*) data;
-    uint64_t enemies = occupancy(board) & ((board->ply & 1) ? board->pieces_w : ~board->pieces_w);
-    int enemy_king = (board->kings >> (6 * (board->ply & 1))) & 0x3F;
+// time limits are off until ponderhit, which restarts the clock
+static bool is_pondering(struct search_state *st) {
+    if (st->pondering && !atomic_load_explicit(st->params.ponder, memory_order_relaxed)) {
+        st->pondering = false;
+        st->tm.start_us = tm_now_us();
+    }
+    return st->pondering;
+}
+
+// info lines for completed iterations are at least this far apart (the last one is always written)
+#define INFO_INTERVAL_US (50000)
+// during a long iteration, a line with the node count and speed is written this often
+#define INFO_PROGRESS_US (1000000)
+
+// nodes searched by all threads so far (slightly behind for threads other than the caller)
+static uint64_t search_nodes(const struct search_state *st) {
+    return atomic_load_explicit(st->nodes, memory_order_relaxed) + (st->stats.nodes & (TM_CHECK_NODES - 1));
+}
+
+// the node count, speed and table usage part of an info line
+static void print_progress(struct search_state *st, uint64_t now_us) {
+    uint64_t elapsed_us = now_us - st->start_us;
+    uint64_t nodes = search_nodes(st);
 
-    int net = 0;
+    fprintf(st->params.out, "nodes %" PRIu64 " nps %" PRIu64 " time %" PRIu64 " hashfull %i",
+        nodes, nodes * 1000000 / (elapsed_us ? elapsed_us : 1), elapsed_us / 1000, tt_hashfull(st->tt));
+}
+
+int mate_moves(int eval) {
+    if (eval <= 32700 && eval >= -32700) return 0;
+
+    // mate scores lose a point per move of the winning side (negamax only lowers winning scores): 32767 is mate
+    // with our next move, -32766 is mated after the opponent's next move
+    return eval > 0 ? 32768 - eval : -(32767 + eval);
+}
+
+// info line for the last completed iteration
+static void print_info(struct search_state *st) {
+    FILE *out = st->params.out;
+    const best_moves_t *result = &st->result;
+    uint64_t now_us = tm_now_us();
+    st->info_us = now_us;
+    st->info_pending = false;
+    if (result->num_moves == 0) return;
+
+    int score = result->moves[0].eval;
+    // the UCI thread writes to the same stream (readyok), so the line is written under the stream's lock
+    flockfile(out);
+    fprintf(out, "info depth %i seldepth %i score ", st->completed_depth, st->seldepth);
+    if (mate_moves(score)) {
+        fprintf(out, "mate %i ", mate_moves(score));
+    } else {
+        fprintf(out, "cp %i ", score);
+    }
+    print_progress(st, now_us);
+
+    fprintf(out, " pv");
+    for (int i = 0; i < result->pv_len; ++i) {
+        char move_name[6];
+        serialize_lan_move(result->pv[i], move_name);
+        fprintf(out, " %s", move_name);
+    }
+    fprintf(out, "\n");
+    // this thread's pawn hash hit rate so far
+    if (st->stats.pawn_probes) fprintf(out, "info string phash %.1f%%\n", 100.0 * st->stats.pawn_hits / st->stats.pawn_probes);
+    fflush(out);
+    funlockfile(out);
+}
+
+// called by the main thread for every node; the clock is only read every TM_CHECK_NODES nodes
+static void check_limits(struct search_state *st) {
+    if (st->params.stop && atomic_load_explicit(st->params.stop, memory_order_relaxed)) {
+        atomic_store_explicit(st->stop, true, memory_order_relaxed);
+        return;
+    }
+
+    bool check_clock = (st->stats.nodes & (TM_CHECK_NODES - 1)) == 0;
+    if (check_clock && st->params.out) {
+        uint64_t now_us = tm_now_us();
+        if (now_us - st->info_us >= INFO_PROGRESS_US) {
+            st->info_us = now_us;
+            flockfile(st->params.out);
+            fprintf(st->params.out, "info ");
+            print_progress(st, now_us);
+            fprintf(st->params.out, "\n");
+            fflush(st->params.out);
+            funlockfile(st->params.out);
+        }
+    }
+
+    if (is_pondering(st)) return;
+
+    if ((st->params.max_nodes && search_nodes(st) >= st->params.max_nodes) || (check_clock && tm_hard_limit(&st->tm))) {
+        atomic_store_explicit(st->stop, true, memory_order_relaxed);
+    }
+}
+
+// a move raised alpha at ply: its line is the move followed by the child's
+static void update_pv(struct search_state *st, int ply, move_t move) {
+    if (ply + 1 >= MAX_PLY) return;
+
+    st->pv[ply][0] = move;
+    memcpy(&st->pv[ply][1], st->pv[ply + 1], st->pv_len[ply + 1] * sizeof(move_t));
+    st->pv_len[ply] = st->pv_len[ply + 1] + 1;
+}
+
+// move ordering scores; captures (MVV-LVA) come first, then promotions, then quiet moves
+#define SCORE_TT (1 << 30)
+#define SCORE_CAPTURE (1 << 20)
+#define SCORE_PROMOTE (SCORE_CAPTURE - 64)
+#define SCORE_KILLER (SCORE_PROMOTE - 64)
+// history scores are kept below the killers
+#define HISTORY_MAX (SCORE_KILLER / 2)
+
+// piece values by ordering rank (the piece_t order isn't by value)
+static const int mvv_lva_rank[NB_ALL_PIECES] = {
+    [PAWN] = 0,
+    [KNIGHT] = 1,
+    [BISHOP] = 2,
+    [ROOK] = 3,
+    [QUEEN] = 4,
+    [KING] = 5
+};
+
+// piece type on a square (KING for kings), -1 if empty
+static int piece_on(const board_t *board, int sq) {
+    if ((board->kings & 0x3F) == sq || (board->kings >> 6) == sq) return KING;
     for (piece_t p = 0; p < NB_PIECES; ++p) {
-        net += ((((board->pieces[p] & enemies) >> r.dst) & 1) - (((board->pieces[p] & enemies) >> l.dst) & 1)) * piece_weights[p];
+        if ((board->pieces[p] >> sq) & 1) return p;
+    }
+    return -1;
+}
+
+// least valuable first; kings go last
+static const piece_t see_order[NB_PIECES] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN};
+
+// static exchange evaluation: material won by the side to move if both sides keep recapturing on the move's
+// destination with their least valuable piece (either may stop when that is better)
+static int see(const board_t *board, move_t move) {
+    int dst = move_dst(move);
+    uint64_t occ = occupancy(board) & ~(1ull << move_src(move));
+    int captured = piece_on(board, dst);
+    int attacker = piece_on(board, move_src(move));
+
+    // gain[d]: material balance after d + 1 captures, from the view of the side making capture d
+    int gain[32];
+    gain[0] = captured >= 0 ? pst_piece_values[captured] : 0;
+    if (move_special(move) == SPECIAL_EN_PASSANT) {
+        gain[0] = pst_piece_values[PAWN];
+        occ &= ~(1ull << (dst ^ 8));
+    } else if (move_special(move) & SPECIAL_PROMOTE) {
+        attacker = move_special(move) & ~SPECIAL_PROMOTE;
+        gain[0] += pst_piece_values[attacker] - pst_piece_values[PAWN];
     }
-    net += ((r.dst == enemy_king) - (l.dst == enemy_king)) * piece_weights[KING];
 
-    return net;
+    uint64_t attackers = attackers_to(board, dst, occ) & occ;
+    // the side to recapture next: 1 for white
+    int white = board->ply & 1;
+    int d = 0;
+
+    while (d < 31) {
+        uint64_t own = attackers & (white ? board->pieces_w : ~board->pieces_w);
+        if (!own) break;
+
+        int next = KING;
+        uint64_t from = 0;
+        for (int i = 0; i < NB_PIECES; ++i) {
+            from = own & board->pieces[see_order[i]];
+            if (from) {
+                next = see_order[i];
+                from &= -from;
+                break;
+            }
+        }
+        if (next == KING) {
+            // the king may only recapture if the other side has nothing left to take it with
+            if (attackers & ~own) break;
+            from = own & -own;
+        }
+
+        ++d;
+        gain[d] = pst_piece_values[attacker] - gain[d - 1];
+        // neither side can come out ahead by going on
+        if (-gain[d - 1] < 0 && gain[d] < 0) break;
+
+        occ &= ~from;
+        // sliders behind the capturing piece join in
+        if (next == PAWN || next == BISHOP || next == QUEEN) attackers |= bishop_attacks(occ, dst) & (board->pieces[BISHOP] | board->pieces[QUEEN]);
+        if (next == ROOK || next == QUEEN) attackers |= rook_attacks(occ, dst) & (board->pieces[ROOK] | board->pieces[QUEEN]);
+        attackers &= occ;
+
+        attacker = next;
+        white ^= 1;
+    }
+
+    // each side only makes a capture if it does better than standing pat
+    for (; d > 0; --d) gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+    return gain[0];
 }
 
-#define MAX_QUIESCE (10)
+// score each move once; moves are then handed out best-first by pick_move(). without a search state (st == NULL)
+// quiet moves get no killer or history score
+static void score_moves(const gamestate_t *gamestate, const struct search_state *st, int ply, const move_t *moves, int *scores, int num_moves, const move_t *tt_move) {
+    const board_t *board = &gamestate->board;
+    const move_t *killers = st && ply < MAX_STACK ? st->killers[ply] : NULL;
+    const int (*history)[64] = st ? st->history[board->ply & 1] : NULL;
+    uint64_t enemies = occupancy(board) & ((board->ply & 1) ? board->pieces_w : ~board->pieces_w);
+
+    for (int i = 0; i < num_moves; ++i) {
+        move_t move = moves[i];
+        int score = 0;
+
+        if (tt_move && move == *tt_move) {
+            score = SCORE_TT;
+        } else if ((enemies >> move_dst(move)) & 1) {
+            int victim = piece_on(board, move_dst(move));
+            int attacker = piece_on(board, move_src(move));
+            score = SCORE_CAPTURE + mvv_lva_rank[victim] * 8 - mvv_lva_rank[attacker];
+            // only taking a cheaper piece can lose material. losing captures go after the quiet moves,
+            // which also keeps quiescence from searching them
+            if (pst_piece_values[attacker] > pst_piece_values[victim]) {
+                int exchange = see(board, move);
+                if (exchange < 0) score = exchange;
+            }
+        } else if (move_special(move) == SPECIAL_EN_PASSANT) {
+            score = SCORE_CAPTURE + mvv_lva_rank[PAWN] * 8 - mvv_lva_rank[PAWN];
+        } else if (killers && move == killers[0]) {
+            score = SCORE_KILLER + 1;
+        } else if (killers && move == killers[1]) {
+            score = SCORE_KILLER;
+        } else if (history) {
+            score = history[move_src(move)][move_dst(move)];
+        }
+
+        if (move_special(move) & SPECIAL_PROMOTE) {
+            int promote_bonus = mvv_lva_rank[move_special(move) & 3] * 8;
+            score = score >= SCORE_CAPTURE ? score + promote_bonus : SCORE_PROMOTE + promote_bonus;
+        }
+
+        scores[i] = score;
+    }
+}
 
-int negamax(const gamestate_t *gamestate, struct search_state *st, int alpha, int beta, int depth) {
-    move_t pl_moves[MAX_MOVES];
-    gamestate_t gs_next;
+// record a quiet move that caused a beta cutoff
+static void update_quiet_cutoff(struct search_state *st, int is_b, int ply, int depth, move_t move) {
+    if (ply < MAX_STACK && move != st->killers[ply][0]) {
+        st->killers[ply][1] = st->killers[ply][0];
+        st->killers[ply][0] = move;
+    }
+
+    int *h = &st->history[is_b][move_src(move)][move_dst(move)];
+    *h += depth * depth;
+    if (*h > HISTORY_MAX) {
+        for (int src = 0; src < 64; ++src) {
+            for (int dst = 0; dst < 64; ++dst) st->history[is_b][src][dst] /= 2;
+        }
+    }
+}
+
+// selection step: swap the best remaining move into position i and return its score
+static int pick_move(move_t *moves, int *scores, int num_moves, int i) {
+    int best = i;
+    for (int j = i + 1; j < num_moves; ++j) {
+        if (scores[j] > scores[best]) best = j;
+    }
+
+    move_t move = moves[best];
+    moves[best] = moves[i];
+    moves[i] = move;
+    int score = scores[best];
+    scores[best] = scores[i];
+    scores[i] = score;
+    return score;
+}
+
+void order_moves(const gamestate_t *gamestate, move_t *moves, int num_moves) {
+    // outside a search there are no killers or history
+    int scores[MAX_MOVES];
+
+    score_moves(gamestate, NULL, 0, moves, scores, num_moves, NULL);
+    for (int i = 0; i < num_moves; ++i) pick_move(moves, scores, num_moves, i);
+}
+
+// pruning margins (centipawns) by depth
+#define REVERSE_FUTILITY_DEPTH (3)
+#define REVERSE_FUTILITY_MARGIN (120)
+#define FUTILITY_DEPTH (2)
+static const int futility_margins[FUTILITY_DEPTH + 1] = {0, 150, 350};
+#define NULL_MOVE_DEPTH (3)
+#define LMR_DEPTH (3)
+#define LMR_MOVES (3)
+
+// move the given move (if present) to the front of the list, keeping the order of the rest
+static void move_to_front(move_t *moves, int num_moves, move_t move) {
+    for (int i = 0; i < num_moves; ++i) {
+        if (moves[i] == move) {
+            memmove(&moves[1], &moves[0], i * sizeof(move_t));
+            moves[0] = move;
+            return;
+        }
+    }
+}
+
+// a draw by repetition: the position occurred earlier in the search tree, or twice before the root.
+// only positions since the last capture or pawn move (ply50) can repeat
+static bool is_repetition(const gamestate_t *gamestate, int ply) {
+    int repeats = 0;
+    for (int i = 4; i <= gamestate->board.ply50; i += 2) {
+        if (gamestate->history[(gamestate->board.ply - i) & (HASH_HISTORY - 1)] != gamestate->hash) continue;
+        if (i < ply || ++repeats == 2) return true;
+    }
+    return false;
+}
+
+int negamax(gamestate_t *gamestate, struct search_state *st, int alpha, int beta, int depth) {
+    undo_t undo;
+
+    if ((++st->stats.nodes & (TM_CHECK_NODES - 1)) == 0) atomic_fetch_add_explicit(st->nodes, TM_CHECK_NODES, memory_order_relaxed);
+    if (st->is_main) check_limits(st);
+    if (depth <= 0) ++st->stats.qnodes;
+
+    int ply = gamestate->board.ply - st->root_ply;
+    if (ply > st->seldepth) st->seldepth = ply;
+    if (ply < MAX_PLY) st->pv_len[ply] = 0;
+    if (is_repetition(gamestate, ply)) return 0;
+
+    int alpha_orig = alpha;
+    tt_entry_t tte;
+    bool tt_hit = depth > 0 && tt_probe(st->tt, gamestate->hash, &tte);
+    if (tt_hit && tte.depth >= depth) {
+        if (tte.bound == TT_BOUND_EXACT) return tte.score;
+        if (tte.bound == TT_BOUND_LOWER && tte.score >= beta) return tte.score;
+        if (tte.bound == TT_BOUND_UPPER && tte.score <= alpha) return tte.score;
+    }
 
     int score = -32767;
     if (depth <= 0) {
-        int cur_eval = (1 - 2 * (gamestate->board.ply & 1)) * static_eval(gamestate);
-        if (depth <= -MAX_QUIESCE || cur_eval > beta) return cur_eval;
+        int cur_eval = (1 - 2 * (gamestate->board.ply & 1)) * evaluate(gamestate, st->pawns, &st->stats);
+        if (depth <= -MAX_QUIESCE || cur_eval >= beta) return cur_eval;
         if (cur_eval > alpha) alpha = cur_eval;
         score = cur_eval;
     }
 
-    int in_check = is_check(&gamestate->board, (gamestate->board.kings >> ((gamestate->board.ply & 1) * 6)) & 0x3F, gamestate->board.ply & 1);
-
-    int num_moves = pseudolegal_moves(gamestate, pl_moves);
-
-    qsort_r(pl_moves, num_moves, sizeof(move_t), (board_t*) &gamestate->board, sort_moves);
-
-    int num_checked = 0;
-    for (int i = 0; !timed_out(st) && i < num_moves; ++i) {
-        memcpy(&gs_next, gamestate, sizeof(gamestate_t));
+    bool is_b = gamestate->board.ply & 1;
+    int in_check = is_check(&gamestate->board, (gamestate->board.kings >> (is_b * 6)) & 0x3F, is_b);
+    // PV nodes (searched with an open window) are never pruned
+    bool is_pv = beta - alpha > 1;
+    unsigned pruning = st->params.pruning;
+
+    int static_score = 0;
+    if (depth > 0 && !in_check && !is_pv && (pruning & (PRUNE_REVERSE_FUTILITY | PRUNE_NULL_MOVE | PRUNE_FUTILITY))) {
+        static_score = (1 - 2 * is_b) * evaluate(gamestate, st->pawns, &st->stats);
+
+        // reverse futility: far enough above beta near the leaves that no quiet line will bring it back
+        if ((pruning & PRUNE_REVERSE_FUTILITY) && depth <= REVERSE_FUTILITY_DEPTH && static_score - REVERSE_FUTILITY_MARGIN * depth >= beta && beta < 32700) {
+            return static_score;
+        }
 
-        int move_exec = execute_move(&gs_next, pl_moves[i]);
+        // null move: if passing still fails high the position is good enough to cut. not tried without
+        // pieces (zugzwang in pawn endgames), and the eval test also stops two null moves in a row
+        uint64_t own = is_b ? ~gamestate->board.pieces_w : gamestate->board.pieces_w;
+        uint64_t own_pieces = own & (gamestate->board.pieces[KNIGHT] | gamestate->board.pieces[BISHOP] | gamestate->board.pieces[ROOK] | gamestate->board.pieces[QUEEN]);
+        if ((pruning & PRUNE_NULL_MOVE) && depth >= NULL_MOVE_DEPTH && own_pieces && static_score >= beta && beta < 32700) {
+            int reduction = 2 + depth / 4;
+            make_null_move(gamestate, &undo);
+            int eval = -negamax(gamestate, st, -beta, -beta + 1, depth - 1 - reduction);
+            unmake_null_move(gamestate, &undo);
+            if (eval >= beta && !should_stop(st)) {
+                ++st->stats.null_move_cutoffs;
+                return eval > 32700 ? beta : eval;
+            }
+        }
+    }
+    bool futile = (pruning & PRUNE_FUTILITY) && depth > 0 && depth <= FUTILITY_DEPTH && !in_check && !is_pv &&
+        static_score + futility_margins[depth] <= alpha && alpha > -32700;
+
+    // depth runs out (quiescence included) before the ply can pass MAX_PLY
+    assert(ply < MAX_PLY);
+    move_t *pl_moves = st->moves[ply];
+    int *scores = st->scores[ply];
+    int num_moves = legal_moves(gamestate, pl_moves);
+    score_moves(gamestate, st, ply, pl_moves, scores, num_moves, tt_hit ? &tte.move : NULL);
+
+    uint64_t occ = occupancy(&gamestate->board);
+    move_t best_move = MOVE_NONE;
+    for (int i = 0; !should_stop(st) && i < num_moves; ++i) {
+        // quiescence only looks at captures that don't lose material unless evading check; they are all picked before any other move
+        if (pick_move(pl_moves, scores, num_moves, i) < SCORE_CAPTURE && depth <= 0 && !in_check) break;
+        bool is_quiet = !((occ >> move_dst(pl_moves[i])) & 1) && move_special(pl_moves[i]) != SPECIAL_EN_PASSANT && !(move_special(pl_moves[i]) & SPECIAL_PROMOTE);
+        bool is_late = is_quiet && i > 0 && scores[i] < SCORE_KILLER;
+
+        int move_exec = make_move(gamestate, pl_moves[i], &undo);
         assert(move_exec >= 0);
 
-        if ((depth <= 0 && !in_check && move_exec == 0) || !is_legal(&gs_next, pl_moves[i])) continue;
-        ++num_checked;
+        bool gives_check = false;
+        if (is_late && (futile || ((pruning & PRUNE_LMR) && depth >= LMR_DEPTH && i >= LMR_MOVES && !in_check))) {
+            gives_check = is_check(&gamestate->board, (gamestate->board.kings >> (!is_b * 6)) & 0x3F, !is_b);
+        }
+
+        // futility: quiet moves can't raise a hopeless static eval above alpha this close to the leaves
+        if (futile && is_late && !gives_check) {
+            unmake_move(gamestate, pl_moves[i], &undo);
+            if (static_score + futility_margins[depth] > score) score = static_score + futility_margins[depth];
+            continue;
+        }
 
         int eval;
-        if (gs_next.board.ply50 >= 50) eval = 0;
-        else if (gs_next.board.checkmate >> (gs_next.board.ply & 1)) eval = 32767;
-        else eval = -negamax(&gs_next, st, -beta, -alpha, depth - 1);
+        if (gamestate->board.ply50 >= 50) {
+            eval = 0;
+            if (ply + 1 < MAX_PLY) st->pv_len[ply + 1] = 0;
+        } else if (i == 0 || depth <= 0) {
+            eval = -negamax(gamestate, st, -beta, -alpha, depth - 1);
+        } else {
+            // late move reductions: later quiet moves (by ordering) are searched shallower first
+            int reduction = 0;
+            if ((pruning & PRUNE_LMR) && is_late && depth >= LMR_DEPTH && i >= LMR_MOVES && !in_check && !gives_check) {
+                reduction = 1 + (i >= 2 * LMR_MOVES) + (depth >= 6);
+                // moves with a good cutoff history are reduced less
+                if (scores[i] > HISTORY_MAX / 64 && reduction > 1) --reduction;
+                if (reduction > depth - 2) reduction = depth - 2;
+            }
+
+            // PVS: prove the move is no better than the best so far with a null window, re-search if not
+            eval = -negamax(gamestate, st, -alpha - 1, -alpha, depth - 1 - reduction);
+            if (reduction > 0 && eval > alpha) eval = -negamax(gamestate, st, -alpha - 1, -alpha, depth - 1);
+            if (eval > alpha && eval < beta) eval = -negamax(gamestate, st, -beta, -alpha, depth - 1);
+        }
+        unmake_move(gamestate, pl_moves[i], &undo);
         // mate finding: avoid longer mate paths by giving worse eval for longer time-to-mate
         if (eval > 32700) eval -= 1;
 
-        if (eval > alpha) alpha = eval;
-        if (eval > score) score = eval;
-        if (alpha > beta) break;
+        if (eval > alpha) {
+            alpha = eval;
+            update_pv(st, ply, pl_moves[i]);
+        }
+        if (eval > score) {
+            score = eval;
+            best_move = pl_moves[i];
+        }
+        if (alpha >= beta) {
+            ++st->stats.cutoffs;
+            if (i == 0) ++st->stats.first_move_cutoffs;
+            if (is_quiet && depth > 0) update_quiet_cutoff(st, gamestate->board.ply & 1, ply, depth, pl_moves[i]);
+            break;
+        }
     }
 
-    return depth > 0 && num_checked == 0 && !in_check ? 0 : score;
-}
+    if (depth > 0 && num_moves == 0 && !in_check) score = 0;
 
-int cmp_engine_move(const void *a, const void *b) {
-    engine_move_t *am = (engine_move_t*) a;
-    engine_move_t *bm = (engine_move_t*) b;
+    // partial results from an interrupted search can't be trusted
+    if (depth > 0 && !should_stop(st)) {
+        tt_bound_t bound = score <= alpha_orig ? TT_BOUND_UPPER : score >= beta ? TT_BOUND_LOWER : TT_BOUND_EXACT;
+        tt_store(st->tt, gamestate->hash, best_move, score, depth, bound);
+    }
 
-    return bm->eval - am->eval;
+    return score;
 }
 
-int search_moves(const gamestate_t *gamestate, search_params_t params, best_moves_t *best_moves) {
-    if (gamestate->board.checkmate) return -1;
+// stable insertion sort by eval, so that among equal evals the move searched first (the one that raised alpha) stays
+// ahead, and an exact eval always outranks an upper bound
+static void sort_root_moves(engine_move_t *moves, int num_moves) {
+    for (int i = 1; i < num_moves; ++i) {
+        engine_move_t em = moves[i];
+        int j = i;
+        while (j > 0 && (moves[j - 1].eval < em.eval || (moves[j - 1].eval == em.eval && moves[j - 1].upper_bound && !em.upper_bound))) {
+            moves[j] = moves[j - 1];
+            --j;
+        }
+        moves[j] = em;
+    }
+}
 
-    struct search_state st;
-    gettimeofday(&st.start_time, NULL);
-    st.timeout_us = params.timeout_ms < 0 || params.max_depth >= 0 ? UINT64_MAX : params.timeout_ms * 1000;
+// aspiration windows start this far either side of the previous iteration's score, doubling on each fail, and are
+// only used once the score from a shallower search is worth trusting
+#define ASPIRATION_DELTA (25)
+#define ASPIRATION_MIN_DEPTH (3)
 
-    for (int initial_depth = 0; initial_depth < MAX_STACK && (params.max_depth < 0 || initial_depth <= params.max_depth); ++initial_depth) {
-        int alpha = -32767;
-        int beta = 32767;
+// search every root move at the given depth within (alpha, beta); evals are filled in for each move, and bounds tells
+// which of them failed low and are therefore only upper bounds
+static int search_root(struct search_state *st, int depth, int alpha, int beta, move_t *moves, int *evals, bool *bounds, int num_moves) {
+    gamestate_t *gamestate = &st->gs;
+    int root_ply = gamestate->board.ply;
+    int best = -32768;
+    undo_t undo;
 
-        if (gamestate->engine_debug) {
-            printf("searching depth %i\n", initial_depth);
+    for (int i = 0; i < num_moves; ++i) evals[i] = -32768;
+    st->pv_len[0] = 0;
+
+    for (int i = 0; !should_stop(st) && i < num_moves; ++i) {
+        int move_exec = make_move(gamestate, moves[i], &undo);
+        assert(move_exec >= 0);
+
+        int eval;
+        if (gamestate->board.ply50 >= 50) {
+            eval = 0;
+            st->pv_len[1] = 0;
+        } else if (depth <= 0) {
+            eval = (1 - 2 * (root_ply & 1)) * evaluate(gamestate, st->pawns, &st->stats);
+            st->pv_len[1] = 0;
+        } else if (i == 0) {
+            eval = -negamax(gamestate, st, -beta, -alpha, depth);
+        } else {
+            eval = -negamax(gamestate, st, -alpha - 1, -alpha, depth);
+            if (eval > alpha && eval < beta) eval = -negamax(gamestate, st, -beta, -alpha, depth);
+        }
+        unmake_move(gamestate, moves[i], &undo);
+        evals[i] = eval;
+        bounds[i] = eval <= alpha;
+
+        // even in a failed-low search, the best move so far gets a line
+        if (eval > best) {
+            best = eval;
+            update_pv(st, 0, moves[i]);
         }
-        move_t pl_moves[MAX_MOVES];
-        int move_evals[MAX_MOVES];
-        gamestate_t gs_next;
+        if (eval > alpha) alpha = eval;
+        if (alpha >= beta) break;
+    }
+
+    return best;
+}
+
+// lines cut short by transposition table hits are continued with the table's moves
+static void extend_pv(tt_t *tt, const gamestate_t *root, best_moves_t *best_moves) {
+    gamestate_t gs = *root;
+    for (int i = 0; i < best_moves->pv_len; ++i) execute_move(&gs, best_moves->pv[i]);
+
+    while (best_moves->pv_len < MAX_PV && !gs.board.checkmate) {
+        tt_entry_t tte;
+        if (!tt_probe(tt, gs.hash, &tte)) return;
 
-        int num_moves = pseudolegal_moves(gamestate, pl_moves);
-        // TODO: sort moves (by static_eval? or a faster heuristic)
+        move_t moves[MAX_MOVES];
+        int num_moves = legal_moves(&gs, moves);
+        int i = 0;
+        while (i < num_moves && moves[i] != tte.move) ++i;
+        if (i == num_moves) return;
+
+        best_moves->pv[best_moves->pv_len++] = moves[i];
+        execute_move(&gs, moves[i]);
+    }
+}
 
-        for (int i = 0; !timed_out(&st) && i < num_moves; ++i) {
-            memcpy(&gs_next, gamestate, sizeof(gamestate_t));
-            assert(execute_move(&gs_next, pl_moves[i]) >= 0);
-            if (!is_legal(&gs_next, pl_moves[i])) {
-                move_evals[i] = -32768;
-                continue;
+// iterative deepening on one thread; results of each completed iteration go to st->result
+static void search_iterate(struct search_state *st) {
+    gamestate_t *gamestate = &st->gs;
+    int max_depth = st->params.max_depth;
+
+    // root moves are kept in the order of the previous iteration's evals; the root is the only user of ply 0 of the move stack
+    move_t *root_moves = st->moves[0];
+    int *move_evals = st->scores[0];
+    bool move_bounds[MAX_MOVES];
+    int num_moves = legal_moves(gamestate, root_moves);
+    tt_entry_t tte;
+    if (tt_probe(st->tt, gamestate->hash, &tte)) move_to_front(root_moves, num_moves, tte.move);
+
+    // recent best move changes (see tm_soft_limit); the time manager allows more time while this is high
+    int instability = 0;
+    move_t prev_best = MOVE_NONE;
+
+    for (int initial_depth = st->start_depth; initial_depth < MAX_STACK && (max_depth < 0 || initial_depth <= max_depth); ++initial_depth) {
+        // keep what was learned last iteration, but let this one's cutoffs dominate
+        for (int c = 0; c < 2; ++c) {
+            for (int src = 0; src < 64; ++src) {
+                for (int dst = 0; dst < 64; ++dst) st->history[c][src][dst] /= 2;
             }
+        }
 
-            int eval;
-            if (gs_next.board.ply50 >= 50) eval = 0;
-            else if (gs_next.board.checkmate) eval = 32767;
-            else if (initial_depth <= 0) eval = (1 - 2 * (gamestate->board.ply & 1)) * static_eval(&gs_next);
-            else eval = -negamax(&gs_next, &st, -beta, -alpha, initial_depth);
-            move_evals[i] = eval;
+        if (gamestate->engine_debug && st->is_main && st->params.out) {
+            fprintf(st->params.out, "info string searching depth %i\n", initial_depth);
+        }
+        st->seldepth = 0;
 
-            if (eval > alpha) alpha = eval;
-            if (alpha > beta) break;
+        // aspiration window around the last score, widened on whichever side it fails
+        int delta = ASPIRATION_DELTA;
+        int alpha = -32767;
+        int beta = 32767;
+        if (initial_depth >= ASPIRATION_MIN_DEPTH && st->completed_depth > 0) {
+            int prev = st->result.moves[0].eval;
+            alpha = prev - delta < -32767 ? -32767 : prev - delta;
+            beta = prev + delta > 32767 ? 32767 : prev + delta;
         }
 
-        if (timed_out(&st) && initial_depth > 0) break;
+        for (;;) {
+            int score = search_root(st, initial_depth, alpha, beta, root_moves, move_evals, move_bounds, num_moves);
+            if (should_stop(st)) break;
+
+            if (score <= alpha && alpha > -32767) {
+                delta *= 2;
+                alpha = score - delta < -32767 ? -32767 : score - delta;
+            } else if (score >= beta && beta < 32767) {
+                // search the move that failed high first next time
+                for (int i = 0; i < num_moves; ++i) {
+                    if (move_evals[i] == score) {
+                        move_to_front(root_moves, num_moves, root_moves[i]);
+                        break;
+                    }
+                }
+                delta *= 2;
+                beta = score + delta > 32767 ? 32767 : score + delta;
+            } else {
+                break;
+            }
+        }
 
+        if (should_stop(st) && initial_depth > 0) break;
+
+        best_moves_t *best_moves = &st->result;
         int m = 0;
         for (int i = 0; i < num_moves; ++i) {
             if (move_evals[i] == -32768) continue;
-            best_moves->moves[m].move = pl_moves[i];
+            best_moves->moves[m].move = root_moves[i];
             best_moves->moves[m].eval = move_evals[i];
+            best_moves->moves[m].upper_bound = move_bounds[i];
             ++m;
         }
         best_moves->num_moves = m;
+        st->completed_depth = initial_depth;
+
+        sort_root_moves(best_moves->moves, m);
+        for (int i = 0; i < m; ++i) root_moves[i] = best_moves->moves[i].move;
+
+        // the best move is the one the line was recorded for, unless the search was cut short before any move got one
+        best_moves->pv_len = 0;
+        if (m > 0 && st->pv_len[0] > 0 && st->pv[0][0] == best_moves->moves[0].move) {
+            best_moves->pv_len = st->pv_len[0] < MAX_PV ? st->pv_len[0] : MAX_PV;
+            memcpy(best_moves->pv, st->pv[0], best_moves->pv_len * sizeof(move_t));
+        } else if (m > 0) {
+            best_moves->pv[0] = best_moves->moves[0].move;
+            best_moves->pv_len = 1;
+        }
+        extend_pv(st->tt, &st->gs, best_moves);
 
-        qsort(best_moves->moves, m, sizeof(engine_move_t), &cmp_engine_move);
+        if (m > 0 && initial_depth > 0) {
+            tt_bound_t bound = best_moves->moves[0].upper_bound ? TT_BOUND_UPPER : TT_BOUND_EXACT;
+            tt_store(st->tt, gamestate->hash, best_moves->moves[0].move, best_moves->moves[0].eval, initial_depth + 1, bound);
+        }
 
-        if (gamestate->engine_debug) {
+        if (gamestate->engine_debug && st->is_main && st->params.out) {
             for (int i = 0; i < m; ++i) {
                 char move_name[6];
                 serialize_lan_move(best_moves->moves[i].move, move_name);
 
-                printf("info (depth %i) move %3i: %s (eval = %i)\n", initial_depth, i, move_name, best_moves->moves[i].eval);
+                fprintf(st->params.out, "info string (depth %i) move %3i: %s (eval = %i)\n", initial_depth, i, move_name, best_moves->moves[i].eval);
             }
         }
 
+        if (st->is_main && st->params.out) {
+            st->info_pending = true;
+            if (tm_now_us() - st->info_us >= INFO_INTERVAL_US) print_info(st);
+        }
+
+        if (m > 0 && initial_depth > 0) {
+            if (prev_best != MOVE_NONE && prev_best != best_moves->moves[0].move) instability += 2;
+            else if (instability > 0) --instability;
+            prev_best = best_moves->moves[0].move;
+        }
+
+        if (st->is_main && (st->params.stop && atomic_load_explicit(st->params.stop, memory_order_relaxed))) break;
+        if (st->is_main && !is_pondering(st) && tm_soft_limit(&st->tm, instability)) break;
+    }
+
+    // helpers keep going until the main thread is done
+    if (st->is_main) {
+        atomic_store_explicit(st->stop, true, memory_order_relaxed);
+        if (st->info_pending) print_info(st);
+    }
+}
+
+static void *search_thread(void *arg) {
+    search_iterate((struct search_state*) arg);
+    return NULL;
+}
+
+int search_moves(const gamestate_t *root, search_params_t params, best_moves_t *best_moves) {
+    if (root->board.checkmate) return -1;
+
+    tt_t *tt = params.tt ? params.tt : &engine_tt;
+    if (!tt->slots && tt_resize(tt, TT_DEFAULT_MB)) return -1;
+
+    int num_threads = params.threads < 1 ? 1 : params.threads > MAX_THREADS ? MAX_THREADS : params.threads;
+    struct search_state *states = calloc(num_threads, sizeof(struct search_state));
+    pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+    if (!states || !threads) {
+        free(states);
+        free(threads);
+        return -1;
+    }
+
+    atomic_bool stop = false;
+    _Atomic uint64_t nodes = 0;
+    time_manager_t tm;
+    tm_init(&tm, &params, root->board.ply & 1);
+
+    for (int t = 0; t < num_threads; ++t) {
+        struct search_state *st = &states[t];
+        st->stop = &stop;
+        st->is_main = t == 0;
+        st->tm = tm;
+        st->pondering = t == 0 && params.ponder && atomic_load(params.ponder);
+        st->params = params;
+        // the search makes and unmakes moves on a single copy of the root position
+        st->gs = *root;
+        st->start_depth = t == 0 ? 0 : 1 + (t & 1);
+        st->root_ply = root->board.ply;
+        st->completed_depth = -1;
+        st->tt = tt;
+        st->nodes = &nodes;
+        st->start_us = st->info_us = tm.start_us;
     }
 
+    // helpers run on new threads; the main search runs on the caller's
+    int num_started = 1;
+    for (; num_started < num_threads; ++num_started) {
+        if (pthread_create(&threads[num_started], NULL, search_thread, &states[num_started])) break;
+    }
+    search_iterate(&states[0]);
+    for (int t = 1; t < num_started; ++t) pthread_join(threads[t], NULL);
+
+    // report the deepest completed iteration; ties go to the main thread
+    struct search_state *best = &states[0];
+    search_stats_t stats = {0};
+    for (int t = 0; t < num_started; ++t) {
+        stats.nodes += states[t].stats.nodes;
+        stats.qnodes += states[t].stats.qnodes;
+        stats.cutoffs += states[t].stats.cutoffs;
+        stats.first_move_cutoffs += states[t].stats.first_move_cutoffs;
+        stats.null_move_cutoffs += states[t].stats.null_move_cutoffs;
+        stats.pawn_probes += states[t].stats.pawn_probes;
+        stats.pawn_hits += states[t].stats.pawn_hits;
+        if (states[t].completed_depth > best->completed_depth && states[t].result.num_moves > 0) best = &states[t];
+    }
+
+    memcpy(best_moves, &best->result, sizeof(best_moves_t));
+    best_moves->stats = stats;
+    best_moves->stats.depth = best->completed_depth;
+
+    free(states);
+    free(threads);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,343 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bitops.h"
+#include "board.h"
+#include "pst.h"
+
+// build step (see meson.build): computes the engine's lookup tables and writes them out as const arrays,
+// so nothing is built at runtime and the tables are shared read-only between engine processes.
+// usage: river-gen-tables output.c
+
+static uint64_t king_moves[64];
+static uint64_t knight_moves[64];
+static uint64_t pawn_attacks[2][64];
+static uint64_t between[64][64];
+static uint64_t line[64][64];
+
+static uint8_t rank_attacks[64][8];
+static uint64_t diags[15];
+static uint64_t antidiags[15];
+
+typedef struct magic_gen {
+    uint64_t mask;
+    uint64_t magic;
+    // start of the square's entries in the attack tables
+    uint64_t offset;
+    int shift;
+} magic_gen_t;
+
+static magic_gen_t rook_magics[64];
+static magic_gen_t bishop_magics[64];
+
+// sum over squares of 2^popcount(mask)
+static uint64_t rook_table[0x19000];
+static uint64_t rook_pext_table[0x19000];
+static uint64_t bishop_table[0x1480];
+static uint64_t bishop_pext_table[0x1480];
+
+static int32_t psq_table[2][NB_PIECES][64][2];
+
+static uint64_t zobrist_pieces[2][NB_ALL_PIECES][64];
+static uint64_t zobrist_castle[16];
+static uint64_t zobrist_en_passant[8];
+static uint64_t zobrist_checkmate[4];
+static uint64_t zobrist_black;
+
+static void init_moves() {
+    for (int i = 0; i < 64; ++i) {
+        uint64_t move = (1ull << i) | ((1ull << i) << 8) | ((1ull << i) >> 8);
+        uint64_t side_moves = (move >> ((i & 7) != 0)) | (move << ((i & 7) != 7));
+
+        king_moves[i] = (move | side_moves) & ~(1ull << i);
+    }
+
+    for (int i = 0; i < 64; ++i) {
+        uint64_t move = 0;
+        for (int xl = 0; xl < 4; ++xl) {
+            int x = (i & 7) - 2 + xl + (xl >> 1);
+            int sdy = (xl & 1) ^ (xl >> 1);
+            for (int yl = 0; yl < 2; ++yl) {
+                int y = (i / 8) - (1 << sdy) + (yl << (sdy + 1));
+                if (x >= 0 && x < 8 && y >= 0 && y < 8) {
+                    move |= 1ull << (y * 8 + x);
+                }
+            }
+        }
+        knight_moves[i] = move;
+    }
+
+    for (int i = 0; i < 64; ++i) {
+        uint64_t side_sqs = (((1ull << i) >> 1) & ~0x8080808080808080ull) | (((1ull << i) << 1) & ~0x0101010101010101ull);
+        pawn_attacks[0][i] = side_sqs << 8;
+        pawn_attacks[1][i] = side_sqs >> 8;
+    }
+}
+
+// walks each ray square by square
+static uint64_t ray_attacks(uint64_t occ, int src, const int dirs[4][2]) {
+    uint64_t atk = 0;
+
+    for (int d = 0; d < 4; ++d) {
+        int rank = (src >> 3) + dirs[d][0];
+        int file = (src & 7) + dirs[d][1];
+
+        for (; rank >= 0 && rank < 8 && file >= 0 && file < 8; rank += dirs[d][0], file += dirs[d][1]) {
+            atk |= 1ull << (rank * 8 + file);
+            if ((occ >> (rank * 8 + file)) & 1) break;
+        }
+    }
+
+    return atk;
+}
+
+static const int rook_dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int bishop_dirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static void init_lines() {
+    for (int a = 0; a < 64; ++a) {
+        for (int b = 0; b < 64; ++b) {
+            if (a == b) continue;
+
+            if ((ray_attacks(0, a, rook_dirs) >> b) & 1) {
+                line[a][b] = (ray_attacks(0, a, rook_dirs) & ray_attacks(0, b, rook_dirs)) | (1ull << a) | (1ull << b);
+                between[a][b] = ray_attacks(1ull << b, a, rook_dirs) & ray_attacks(1ull << a, b, rook_dirs);
+            } else if ((ray_attacks(0, a, bishop_dirs) >> b) & 1) {
+                line[a][b] = (ray_attacks(0, a, bishop_dirs) & ray_attacks(0, b, bishop_dirs)) | (1ull << a) | (1ull << b);
+                between[a][b] = ray_attacks(1ull << b, a, bishop_dirs) & ray_attacks(1ull << a, b, bishop_dirs);
+            }
+        }
+    }
+}
+
+static void init_hq() {
+    for (int occ = 0; occ < 64; ++occ) {
+        for (int f = 0; f < 8; ++f) {
+            int mask_lo = (1 << f) - 1;
+            int mask_hi = -(2 << f);
+
+            int lo = 31 - CLZ32(((occ << 1) & mask_lo) | 1);
+            int hi = CTZ32(((occ << 1) & mask_hi) | 128);
+
+            // the file's own square is excluded to match the other backends
+            rank_attacks[occ][f] = ((2 << hi) - (1 << lo)) & ~(1 << f);
+        }
+    }
+
+    for (int diag = 0; diag < 15; ++diag) {
+        for (int rank = 0; rank < 8; ++rank) {
+            int file = diag - rank;
+            diags[diag] |= 0 <= file && file < 8 ? (1ull << (rank * 8 + file)) : 0;
+            antidiags[diag] |= 0 <= file && file < 8 ? (1ull << (rank * 8 + 7 - file)) : 0;
+        }
+    }
+}
+
+// xorshift64*; seeded per rank by init_magics() so the magics are the same every build
+static uint64_t magic_rand(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static void init_magics(magic_gen_t *magics, uint64_t *table, uint64_t *pext_table, const int dirs[4][2]) {
+    static uint64_t occs[4096];
+    static uint64_t atks[4096];
+    static int epoch[4096];
+    // per-rank seeds known to find magics quickly with this generator
+    static const uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+    int cur_epoch = 0;
+    uint64_t offset = 0;
+
+    memset(epoch, 0, sizeof(epoch));
+
+    for (int sq = 0; sq < 64; ++sq) {
+        magic_gen_t *m = &magics[sq];
+        uint64_t *attacks = &table[offset];
+
+        uint64_t edges = ((0x00000000000000FFull | 0xFF00000000000000ull) & ~(0xFFull << (sq & 0x38))) |
+            ((0x0101010101010101ull | 0x8080808080808080ull) & ~(0x0101010101010101ull << (sq & 7)));
+        m->mask = ray_attacks(0, sq, dirs) & ~edges;
+        m->shift = 64 - POPCNT64(m->mask);
+        m->offset = offset;
+
+        // carry-rippler enumeration visits subsets in pext index order
+        int size = 0;
+        uint64_t occ = 0;
+        do {
+            occs[size] = occ;
+            atks[size] = ray_attacks(occ, sq, dirs);
+            pext_table[offset + size] = atks[size];
+            ++size;
+            occ = (occ - m->mask) & m->mask;
+        } while (occ != 0);
+
+        uint64_t seed = seeds[sq >> 3];
+        for (bool found = false; !found;) {
+            do {
+                m->magic = magic_rand(&seed) & magic_rand(&seed) & magic_rand(&seed);
+            } while (POPCNT64((m->mask * m->magic) >> 56) < 6);
+
+            ++cur_epoch;
+            found = true;
+            for (int i = 0; i < size; ++i) {
+                uint64_t idx = (occs[i] * m->magic) >> m->shift;
+
+                if (epoch[idx] < cur_epoch) {
+                    epoch[idx] = cur_epoch;
+                    attacks[idx] = atks[i];
+                } else if (attacks[idx] != atks[i]) {
+                    found = false;
+                    break;
+                }
+            }
+        }
+
+        offset += size;
+    }
+}
+
+static void init_psq() {
+    for (piece_t p = 0; p < NB_PIECES; ++p) {
+        for (int sq = 0; sq < 64; ++sq) {
+            for (int is_endgame = 0; is_endgame < 2; ++is_endgame) {
+                const int8_t (*pst)[64] = is_endgame ? pst_eg : pst_mg;
+                psq_table[0][p][sq][is_endgame] = pst_piece_values[p] + pst[p][sq];
+                // black's tables are mirrored vertically
+                psq_table[1][p][sq][is_endgame] = -(pst_piece_values[p] + pst[p][sq ^ 0x38]);
+            }
+        }
+    }
+}
+
+// splitmix64; fixed seed so hashes are reproducible between builds
+static uint64_t zobrist_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void init_zobrist() {
+    uint64_t state = 0x52495645522D5357ull;
+    for (int c = 0; c < 2; ++c) {
+        for (int p = 0; p < NB_ALL_PIECES; ++p) {
+            for (int sq = 0; sq < 64; ++sq) zobrist_pieces[c][p][sq] = zobrist_next(&state);
+        }
+    }
+
+    // no rights / no flags hash to 0 so an empty state doesn't need special handling
+    zobrist_castle[0] = 0;
+    for (int i = 1; i < 16; ++i) zobrist_castle[i] = zobrist_next(&state);
+    for (int i = 0; i < 8; ++i) zobrist_en_passant[i] = zobrist_next(&state);
+    zobrist_checkmate[0] = 0;
+    for (int i = 1; i < 4; ++i) zobrist_checkmate[i] = zobrist_next(&state);
+    zobrist_black = zobrist_next(&state);
+}
+
+// writes the braced initializer of an array with the given dimensions, reading values in row-major order.
+// hex values are zero-padded to width digits; width 0 writes signed decimals
+static const int64_t *write_values(FILE *out, const int64_t *values, const int *dims, int num_dims, int width, int indent) {
+    fprintf(out, "{");
+    for (int i = 0; i < dims[0]; ++i) {
+        if (num_dims > 1) {
+            fprintf(out, "\n%*s", indent + 4, "");
+            values = write_values(out, values, dims + 1, num_dims - 1, width, indent + 4);
+            fprintf(out, ",");
+            continue;
+        }
+
+        int per_line = width ? 64 / (width + 4) : 16;
+        fprintf(out, i % per_line ? " " : "\n%*s", indent + 4, "");
+        if (width) fprintf(out, "0x%0*" PRIx64 ",", width, (uint64_t) *values++);
+        else fprintf(out, "%" PRIi64 ",", *values++);
+    }
+    fprintf(out, "\n%*s}", indent, "");
+    return values;
+}
+
+static int64_t values[0x19000];
+
+static void write_u64(FILE *out, const char *decl, const uint64_t *table, const int *dims, int num_dims) {
+    size_t n = 1;
+    for (int d = 0; d < num_dims; ++d) n *= dims[d];
+    for (size_t i = 0; i < n; ++i) values[i] = (int64_t) table[i];
+
+    fprintf(out, "%s = ", decl);
+    write_values(out, values, dims, num_dims, 16, 0);
+    fprintf(out, ";\n\n");
+}
+
+static void write_magics(FILE *out, const char *name, const magic_gen_t *magics, const char *table, const char *pext_table) {
+    fprintf(out, "const magic_t %s[64] = {\n", name);
+    for (int sq = 0; sq < 64; ++sq) {
+        const magic_gen_t *m = &magics[sq];
+        fprintf(out, "    {0x%016" PRIx64 ", 0x%016" PRIx64 ", &%s[%" PRIu64 "], &%s[%" PRIu64 "], %i},\n",
+            m->mask, m->magic, table, m->offset, pext_table, m->offset, m->shift);
+    }
+    fprintf(out, "};\n\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s output.c\n", argv[0]);
+        return 1;
+    }
+
+    init_moves();
+    init_lines();
+    init_hq();
+    init_magics(rook_magics, rook_table, rook_pext_table, rook_dirs);
+    init_magics(bishop_magics, bishop_table, bishop_pext_table, bishop_dirs);
+    init_psq();
+    init_zobrist();
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "// generated by gen_tables.c; do not edit\n\n#include \"tables.h\"\n#include \"tt.h\"\n\n");
+
+    write_u64(out, "const uint64_t king_moves[64]", king_moves, (int[]) {64}, 1);
+    write_u64(out, "const uint64_t knight_moves[64]", knight_moves, (int[]) {64}, 1);
+    write_u64(out, "const uint64_t pawn_attacks[2][64]", &pawn_attacks[0][0], (int[]) {2, 64}, 2);
+    write_u64(out, "const uint64_t between[64][64]", &between[0][0], (int[]) {64, 64}, 2);
+    write_u64(out, "const uint64_t line[64][64]", &line[0][0], (int[]) {64, 64}, 2);
+
+    for (int i = 0; i < 64 * 8; ++i) values[i] = rank_attacks[i / 8][i % 8];
+    fprintf(out, "const uint8_t rank_attacks[64][8] = ");
+    write_values(out, values, (int[]) {64, 8}, 2, 2, 0);
+    fprintf(out, ";\n\n");
+    write_u64(out, "const uint64_t diags[15]", diags, (int[]) {15}, 1);
+    write_u64(out, "const uint64_t antidiags[15]", antidiags, (int[]) {15}, 1);
+
+    write_u64(out, "static const uint64_t rook_table[0x19000]", rook_table, (int[]) {0x19000}, 1);
+    write_u64(out, "static const uint64_t rook_pext_table[0x19000]", rook_pext_table, (int[]) {0x19000}, 1);
+    write_u64(out, "static const uint64_t bishop_table[0x1480]", bishop_table, (int[]) {0x1480}, 1);
+    write_u64(out, "static const uint64_t bishop_pext_table[0x1480]", bishop_pext_table, (int[]) {0x1480}, 1);
+    write_magics(out, "rook_magics", rook_magics, "rook_table", "rook_pext_table");
+    write_magics(out, "bishop_magics", bishop_magics, "bishop_table", "bishop_pext_table");
+
+    const int32_t *psq = &psq_table[0][0][0][0];
+    for (int i = 0; i < 2 * NB_PIECES * 64 * 2; ++i) values[i] = psq[i];
+    fprintf(out, "const int32_t psq_table[2][NB_PIECES][64][2] = ");
+    write_values(out, values, (int[]) {2, NB_PIECES, 64, 2}, 4, 0, 0);
+    fprintf(out, ";\n\n");
+
+    write_u64(out, "const uint64_t zobrist_pieces[2][NB_ALL_PIECES][64]", &zobrist_pieces[0][0][0], (int[]) {2, NB_ALL_PIECES, 64}, 3);
+    write_u64(out, "const uint64_t zobrist_castle[16]", zobrist_castle, (int[]) {16}, 1);
+    write_u64(out, "const uint64_t zobrist_en_passant[8]", zobrist_en_passant, (int[]) {8}, 1);
+    write_u64(out, "const uint64_t zobrist_checkmate[4]", zobrist_checkmate, (int[]) {4}, 1);
+    fprintf(out, "const uint64_t zobrist_black = 0x%016" PRIx64 ";\n", zobrist_black);
+
+    if (fclose(out)) {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef _ANALYZE_H
+#define _ANALYZE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum analyze_format {
+    ANALYZE_CSV = 0,
+    ANALYZE_JSONL = 1
+} analyze_format_t;
+
+typedef struct analyze_params {
+    // fixed depth per position; -1 for none (then nodes must be set)
+    int depth;
+    // node budget per position; 0 for none
+    uint64_t nodes;
+    // positions searched in parallel, each by a single search thread with its own table
+    int workers;
+    // transposition table size per worker in MiB
+    size_t hash_mb;
+    analyze_format_t format;
+} analyze_params_t;
+
+// search every position (a FEN or EPD per line) from in, writing one result per position to out in input order.
+// throughput is reported on stderr; returns nonzero if any position couldn't be analysed
+int analyze_start(FILE *in, FILE *out, analyze_params_t params);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _ATTACKS_H
+#define _ATTACKS_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+typedef enum attack_backend {
+    // hyperbola quintessence; portable, no large tables
+    ATTACKS_HQ = 0,
+    // fancy magic bitboards
+    ATTACKS_MAGIC = 1,
+    // BMI2 PEXT-indexed tables (x86 only)
+    ATTACKS_PEXT = 2,
+    NB_ATTACK_BACKENDS = 3
+} attack_backend_t;
+
+extern const char *attack_backend_names[NB_ATTACK_BACKENDS];
+
+// slider attacks from src given an occupancy (src itself excluded); dispatches to the selected backend
+extern uint64_t (*rook_attacks)(uint64_t occ, int src);
+extern uint64_t (*bishop_attacks)(uint64_t occ, int src);
+
+// the fastest backend the CPU supports is selected at startup (magics rather than PEXT on AMD before Zen 3)
+bool attacks_supported(attack_backend_t backend);
+// returns -1 if the backend isn't supported on this CPU
+int attacks_select(attack_backend_t backend);
+attack_backend_t attacks_selected();
+
+#endif
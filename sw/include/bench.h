@@ -0,0 +1,20 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <inttypes.h>
+#include <stdio.h>
+
+// default search depth of the bench suite
+#define BENCH_DEPTH (7)
+// the bench uses its own table of a fixed size, so its node count doesn't depend on the Hash option
+#define BENCH_HASH_MB (16)
+
+// the bench positions (FEN), also used by the standalone benchmarks
+extern const char *const bench_fens[];
+extern const int num_bench_fens;
+
+// search the embedded positions in order to a fixed depth on one thread and print the node count, time and speed.
+// the node count only changes when the search does; returns nonzero on failure
+int bench_run(FILE *out, int depth, uint64_t *nodes);
+
+#endif
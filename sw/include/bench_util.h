@@ -0,0 +1,37 @@
+#ifndef _BENCH_UTIL_H
+#define _BENCH_UTIL_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "board.h"
+#include "engine.h"
+
+// helpers shared by the standalone benchmarks (attacks_bench.c, microbench.c, smp_bench.c)
+
+typedef struct slider_sample {
+    uint64_t occ;
+    int sq;
+} slider_sample_t;
+
+// rook and bishop attack queries taken from real positions (queens count as both)
+typedef struct slider_samples {
+    slider_sample_t *rook;
+    slider_sample_t *bishop;
+    int num_rook;
+    int num_bishop;
+    // capacity of each array
+    int max;
+} slider_samples_t;
+
+// parse one of the bench positions (see bench_fens); returns nonzero on failure
+int bench_position(gamestate_t *gs, int index);
+// call visit at every node of the legal move tree below gs, down to depth plies; a node is only expanded if its visit
+// returns true
+void bench_walk(gamestate_t *gs, int depth, bool (*visit)(gamestate_t *gs, void *ctx), void *ctx);
+// add a sample for every slider on the board, up to samples->max of each kind
+void bench_sample_sliders(slider_samples_t *samples, const board_t *board);
+// call run (which returns how many calls it timed) repeatedly until at least min_us passed; returns the elapsed time in
+// ns, and the total number of calls in calls
+double bench_time(uint64_t (*run)(void *ctx), void *ctx, uint64_t min_us, uint64_t *calls);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _BITOPS_H
+#define _BITOPS_H
+
+#ifndef __has_builtin
+#define __has_builtin(x) (0)
+#endif
+
+#if __has_builtin(__builtin_ctzll) && __has_builtin(__builtin_bswap64) && __has_builtin(__builtin_popcountll)
+#define CTZ64 __builtin_ctzll
+#define CTZ32 __builtin_ctz
+#define CLZ64 __builtin_clzll
+#define CLZ32 __builtin_clz
+#define BS64 __builtin_bswap64
+#define BS32 __builtin_bswap32
+#define POPCNT32 __builtin_popcount
+#define POPCNT64 __builtin_popcountll
+#else
+#error Unsupported compiler
+#endif
+
+#endif
@@ -54,10 +54,26 @@ typedef enum move_special {
     SPECIAL_PROMOTE_QUEEN = 7
 } move_special_t;
 
-typedef struct move {
-    uint8_t src: 6;
-    uint8_t dst: 6;
-    move_special_t special: 3;
-} move_t;
+// moves are packed as src << 9 | dst << 3 | special, so that one fits (and compares) as a single 16-bit value
+typedef uint16_t move_t;
+
+// a move that is never generated (for an empty or unparseable move)
+#define MOVE_NONE ((move_t) SPECIAL_UNKNOWN)
+
+static inline move_t move_new(int src, int dst, move_special_t special) {
+    return (move_t) ((src << 9) | (dst << 3) | special);
+}
+
+static inline int move_src(move_t move) {
+    return move >> 9;
+}
+
+static inline int move_dst(move_t move) {
+    return (move >> 3) & 0x3F;
+}
+
+static inline move_special_t move_special(move_t move) {
+    return (move_special_t) (move & 0x7);
+}
 
 #endif
@@ -1,41 +1,164 @@
 #ifndef _ENGINE_H
 #define _ENGINE_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 #include "board.h"
 
 // max moves ever constructed is 218 - use 256 to be safe
 #define MAX_MOVES (256)
+// max search threads (UCI Threads option)
+#define MAX_THREADS (256)
+// longest principal variation reported
+#define MAX_PV (64)
+// past position hashes kept for repetition detection (power of 2); must cover ply50 plus the search stack
+#define HASH_HISTORY (256)
 
 typedef int16_t eval_t;
 
 typedef struct gamestate {
     board_t board;
-    // TODO: other context (for 3-move rule etc.)
+    // zobrist hash of board; derived state here is kept in sync by execute_move()
+    uint64_t hash;
+    // zobrist hash of the pawns only, kept in sync the same way
+    uint64_t pawn_hash;
+    // material + piece-square score (kings excluded) from white's view with the midgame [0] and endgame [1] tables
+    int32_t psq[2];
+    // game phase (sum of pst_phase_weights); blends the midgame and endgame scores
+    int16_t phase;
+    // hashes of earlier positions, indexed by board ply % HASH_HISTORY; make_move() records the position it leaves
+    uint64_t history[HASH_HISTORY];
     bool engine_debug;
 } gamestate_t;
 
+// state needed to take back a move; filled in by make_move()
+typedef struct undo {
+    uint64_t hash;
+    uint64_t pawn_hash;
+    uint64_t pieces_w;
+    // special field with SPECIAL_UNKNOWN resolved
+    uint8_t special;
+    // moved piece (KING for king moves) and captured piece (-1 if none)
+    int8_t piece;
+    int8_t captured;
+    uint8_t checkmate;
+    uint8_t en_passant;
+    uint8_t castle;
+    uint8_t ply50;
+    int16_t phase;
+    int32_t psq[2];
+} undo_t;
+
 typedef struct engine_move {
     move_t move;
     eval_t eval;
+    // the move failed low against a null window, so eval is only an upper bound
+    bool upper_bound;
 } engine_move_t;
 
+typedef struct search_stats {
+    // nodes visited by all threads, and how many of them were in quiescence
+    uint64_t nodes;
+    uint64_t qnodes;
+    // beta cutoffs, and how many of them came from the first move searched (ordering quality)
+    uint64_t cutoffs;
+    uint64_t first_move_cutoffs;
+    uint64_t null_move_cutoffs;
+    // pawn structure evaluations, and how many of them were found in the pawn hash table
+    uint64_t pawn_probes;
+    uint64_t pawn_hits;
+    // deepest completed iteration
+    int depth;
+} search_stats_t;
+
 typedef struct best_moves {
     engine_move_t moves[MAX_MOVES];
     uint8_t num_moves;
+    // principal variation starting with moves[0].move
+    move_t pv[MAX_PV];
+    uint8_t pv_len;
+    search_stats_t stats;
 } best_moves_t;
 
+// pruning and reductions applied by the search (search_params_t.pruning)
+typedef enum prune_flags {
+    PRUNE_NULL_MOVE = 1,
+    PRUNE_LMR = 2,
+    PRUNE_REVERSE_FUTILITY = 4,
+    PRUNE_FUTILITY = 8,
+    PRUNE_ALL = 15
+} prune_flags_t;
+
 typedef struct search_params {
+    // fixed time for the move (UCI movetime); -1 to use the clock below instead
     int timeout_ms;
+    // fixed depth (ignores all time limits); -1 for none
     int max_depth;
+    // clock and increment of each side ([0] = white) in ms; a clock of 0 means no time limit
+    int time_left_ms[2];
+    int increment_ms[2];
+    // moves until the next time control; 0 for sudden death
+    int moves_to_go;
+    // stop once all threads together searched this many nodes; 0 for no limit
+    uint64_t max_nodes;
+    // lazy SMP: all threads search the same root, sharing only the transposition table
+    int threads;
+    // prune_flags_t bitmask
+    unsigned pruning;
+    // if set, the search stops (returning the last completed iteration) once this becomes true
+    atomic_bool *stop;
+    // if set, time limits don't apply while this is true; the clock starts when it is cleared (ponderhit)
+    atomic_bool *ponder;
+    // if set, UCI info lines (and debug output) are written here while searching
+    FILE *out;
+    // transposition table to use (allocated by the caller); NULL for the shared engine_tt
+    struct tt *tt;
 } search_params_t;
 
+typedef struct perft_params {
+    // threads splitting the root moves
+    int threads;
+    // size of the subtree count cache in MiB (0 disables it)
+    size_t hash_mb;
+} perft_params_t;
+
+// node counts below each root move
+typedef struct perft_divide {
+    move_t moves[MAX_MOVES];
+    uint64_t counts[MAX_MOVES];
+    int num_moves;
+} perft_divide_t;
+
 // for now, assume engine is stateless with regards to the game
 // later, may make it stateful (e.g. to keep past positions known)
 int search_moves(const gamestate_t *gamestate, search_params_t params, best_moves_t *best_moves);
+// generate all legal moves for the side to move; returns the number of moves
+int legal_moves(const gamestate_t *gamestate, move_t *moves);
+// moves that may leave the own king in check (legal_moves() filters these); returns the number of moves
+int pseudolegal_moves(const gamestate_t *gamestate, move_t *moves);
+// all occupied squares (kings included)
+uint64_t occupancy(const board_t *board);
+// whether the king of the given side, if it stood on square king, would be attacked
+int is_check(const board_t *board, int king, int is_b);
+// evaluation from white's view
+int static_eval(const gamestate_t *gamestate);
+// sort moves the way the search orders them at a node without killers or history
+void order_moves(const gamestate_t *gamestate, move_t *moves, int num_moves);
+// recompute derived state (e.g. hash) after the board was set directly
+void gamestate_init(gamestate_t *gamestate);
 // execute a move on the game state
 int execute_move(gamestate_t *gamestate, move_t move);
+// execute a move, recording what is needed to undo it; same return value as execute_move()
+int make_move(gamestate_t *gamestate, move_t move, undo_t *undo);
+// take back a move made with make_move()
+void unmake_move(gamestate_t *gamestate, move_t move, const undo_t *undo);
+// moves until mate for a mate score (negative when the side to move gets mated); 0 for other scores
+int mate_moves(int eval);
 // perft correctness test
 uint64_t perft(const gamestate_t *gamestate, int depth);
+// parallel (and optionally memoised) perft; fills in per-root-move counts if divide is non-NULL
+uint64_t perft_divide(const gamestate_t *gamestate, int depth, perft_params_t params, perft_divide_t *divide);
 
 #endif
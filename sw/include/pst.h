@@ -0,0 +1,170 @@
+#ifndef _PST_H
+#define _PST_H
+
+#include "board.h"
+
+// evaluation constants; all tables are from white's point of view (black mirrors the rank) and
+// indexed by square, a1 = 0. the piece values and midgame tables (plus the king's endgame table)
+// are the values in the hardware pst/pst_sq modules (hw/hdl/move_evaluator.sv); keep them in sync
+
+static const int16_t pst_piece_values[NB_ALL_PIECES] = {
+    [KNIGHT] = 300,
+    [BISHOP] = 340,
+    [ROOK] = 550,
+    [QUEEN] = 1000,
+    [PAWN] = 100,
+    [KING] = 15000
+};
+
+static const int8_t pst_mg[NB_ALL_PIECES][64] = {
+    [KNIGHT] = {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    [BISHOP] = {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    [ROOK] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0,
+    },
+    [QUEEN] = {
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+          0,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   5,   5,   5,   5,   5,   0, -10,
+        -10,   0,   5,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    [PAWN] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,   5,  10,  25,  25,  10,   5,   5,
+         10,  10,  20,  30,  30,  20,  10,  10,
+         50,  50,  50,  50,  50,  50,  50,  50,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [KING] = {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20,
+    },
+};
+
+static const int8_t pst_eg[NB_ALL_PIECES][64] = {
+    [KNIGHT] = {
+        -40, -30, -20, -15, -15, -20, -30, -40,
+        -30, -15,  -5,   0,   0,  -5, -15, -30,
+        -20,  -5,  10,  15,  15,  10,  -5, -20,
+        -15,   0,  15,  20,  20,  15,   0, -15,
+        -15,   0,  15,  20,  20,  15,   0, -15,
+        -20,  -5,  10,  15,  15,  10,  -5, -20,
+        -30, -15,  -5,   0,   0,  -5, -15, -30,
+        -40, -30, -20, -15, -15, -20, -30, -40,
+    },
+    [BISHOP] = {
+        -20, -15, -10,  -8,  -8, -10, -15, -20,
+        -15,  -8,  -3,   0,   0,  -3,  -8, -15,
+        -10,  -3,   5,   7,   7,   5,  -3, -10,
+         -8,   0,   7,  10,  10,   7,   0,  -8,
+         -8,   0,   7,  10,  10,   7,   0,  -8,
+        -10,  -3,   5,   7,   7,   5,  -3, -10,
+        -15,  -8,  -3,   0,   0,  -3,  -8, -15,
+        -20, -15, -10,  -8,  -8, -10, -15, -20,
+    },
+    [ROOK] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [QUEEN] = {
+        -20, -15, -10,  -8,  -8, -10, -15, -20,
+        -15,  -8,  -3,   0,   0,  -3,  -8, -15,
+        -10,  -3,   5,   7,   7,   5,  -3, -10,
+         -8,   0,   7,  10,  10,   7,   0,  -8,
+         -8,   0,   7,  10,  10,   7,   0,  -8,
+        -10,  -3,   5,   7,   7,   5,  -3, -10,
+        -15,  -8,  -3,   0,   0,  -3,  -8, -15,
+        -20, -15, -10,  -8,  -8, -10, -15, -20,
+    },
+    [PAWN] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,   5,   5,   5,   5,   5,   5,   5,
+         15,  15,  15,  15,  15,  15,  15,  15,
+         30,  30,  30,  30,  30,  30,  30,  30,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         80,  80,  80,  80,  80,  80,  80,  80,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [KING] = {
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10,   0,   0, -10, -20, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -30,   0,   0,   0,   0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50,
+    },
+};
+
+// contribution of each piece to the game phase (78 with all pieces on the board)
+static const int8_t pst_phase_weights[NB_ALL_PIECES] = {
+    [KNIGHT] = 3,
+    [BISHOP] = 3,
+    [ROOK] = 5,
+    [QUEEN] = 9,
+    [PAWN] = 1,
+    [KING] = 0
+};
+
+// the eval is blended linearly from the endgame tables at PST_PHASE_EG to the midgame tables at PST_PHASE_MG
+#define PST_PHASE_EG (16)
+#define PST_PHASE_MG (64)
+
+// pawn structure terms (software only; the hardware evaluator has none), as {midgame, endgame} penalties per pawn
+static const int8_t pst_doubled_pawn[2] = {-10, -20};
+static const int8_t pst_isolated_pawn[2] = {-10, -15};
+// pawn whose stop square is attacked by an enemy pawn and can't be defended by an own pawn advancing
+static const int8_t pst_backward_pawn[2] = {-8, -10};
+// passed pawn bonus by [is_endgame][relative rank] (0 = own back rank)
+static const int16_t pst_passed_pawn[2][8] = {
+    {0, 5, 10, 15, 25, 40, 60, 0},
+    {0, 10, 15, 25, 45, 75, 120, 0},
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _TABLES_H
+#define _TABLES_H
+
+#include <inttypes.h>
+#include "board.h"
+
+// lookup tables computed at build time by gen_tables.c (into the generated tables.c); all read-only
+
+extern const uint64_t king_moves[64];
+extern const uint64_t knight_moves[64];
+// squares attacked by a pawn of the given color (0 = white) on a square
+extern const uint64_t pawn_attacks[2][64];
+// squares strictly between two aligned squares, and the full line through them (0 if not aligned)
+extern const uint64_t between[64][64];
+extern const uint64_t line[64][64];
+
+// hyperbola quintessence: rank attacks by [inner 6 bits of the rank's occupancy][file], and the masks of each
+// diagonal (rank + file) and antidiagonal (rank + 7 - file)
+extern const uint8_t rank_attacks[64][8];
+extern const uint64_t diags[15];
+extern const uint64_t antidiags[15];
+
+typedef struct magic {
+    // relevant occupancy (excludes the edges the ray ends on)
+    uint64_t mask;
+    uint64_t magic;
+    // attacks indexed by ((occ & mask) * magic) >> shift
+    const uint64_t *attacks;
+    // attacks indexed by pext(occ, mask)
+    const uint64_t *pext_attacks;
+    int shift;
+} magic_t;
+
+extern const magic_t rook_magics[64];
+extern const magic_t bishop_magics[64];
+
+// signed material + piece-square value of a (non-king) piece, by [is_b][piece][square][is_endgame]
+extern const int32_t psq_table[2][NB_PIECES][64][2];
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _TIMEMAN_H
+#define _TIMEMAN_H
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include "engine.h"
+
+// the search only looks at the clock once every this many nodes (power of 2)
+#define TM_CHECK_NODES (1024)
+// time kept in reserve per move for communication delays (ms)
+#define TM_MOVE_OVERHEAD_MS (30)
+
+typedef struct time_manager {
+    uint64_t start_us;
+    // don't start another iteration past the soft limit (scaled up when the best move is unstable)
+    uint64_t soft_us;
+    // stop searching at the hard limit
+    uint64_t hard_us;
+} time_manager_t;
+
+// monotonic time in microseconds
+uint64_t tm_now_us();
+// set up the limits for a search by the given side; starts the clock
+void tm_init(time_manager_t *tm, const search_params_t *params, bool is_b);
+uint64_t tm_elapsed_us(const time_manager_t *tm);
+bool tm_hard_limit(const time_manager_t *tm);
+// whether to stop after an iteration; instability goes up by 2 for each best move change and down by 1 for each
+// iteration that keeps the best move
+bool tm_soft_limit(const time_manager_t *tm, int instability);
+
+#endif
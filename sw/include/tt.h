@@ -0,0 +1,70 @@
+#ifndef _TT_H
+#define _TT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "board.h"
+
+// default and max transposition table sizes in MiB (UCI Hash option)
+#define TT_DEFAULT_MB (16)
+#define TT_MAX_MB (65536)
+
+// zobrist keys (generated at build time by gen_tables.c); pieces indexed by [is_b][piece][square] (KING included)
+extern const uint64_t zobrist_pieces[2][NB_ALL_PIECES][64];
+extern const uint64_t zobrist_castle[16];
+extern const uint64_t zobrist_en_passant[8];
+extern const uint64_t zobrist_checkmate[4];
+extern const uint64_t zobrist_black;
+
+// hash of everything except the pieces and side to move (castling, en-passant, checkmate flags)
+static inline uint64_t zobrist_flags(const board_t *board) {
+    return zobrist_castle[board->castle] ^ zobrist_checkmate[board->checkmate] ^
+        ((board->en_passant & 8) ? zobrist_en_passant[board->en_passant & 7] : 0);
+}
+// full hash of a board; execute_move() keeps this up to date incrementally
+uint64_t zobrist_hash(const board_t *board);
+// hash of the pawns alone (keys the pawn structure eval cache)
+uint64_t zobrist_pawn_hash(const board_t *board);
+
+typedef enum tt_bound {
+    TT_BOUND_NONE = 0,
+    // score <= true eval
+    TT_BOUND_LOWER = 1,
+    // score >= true eval
+    TT_BOUND_UPPER = 2,
+    TT_BOUND_EXACT = 3
+} tt_bound_t;
+
+typedef struct tt_entry {
+    move_t move;
+    int16_t score;
+    int8_t depth;
+    uint8_t bound;
+} tt_entry_t;
+
+// entries are packed into data; key holds hash ^ data so a slot torn by concurrent writers reads as a miss
+typedef struct tt_slot {
+    _Atomic uint64_t key;
+    _Atomic uint64_t data;
+} tt_slot_t;
+
+typedef struct tt {
+    tt_slot_t *slots;
+    // number of slots - 1 (always a power of 2)
+    uint64_t mask;
+} tt_t;
+
+// table used by the engine's search; shared (without locks) by all search threads
+extern tt_t engine_tt;
+
+// (re)allocate the table with the largest power-of-2 slot count fitting in size_mb MiB; clears it
+int tt_resize(tt_t *tt, size_t size_mb);
+void tt_clear(tt_t *tt);
+void tt_free(tt_t *tt);
+// approximate occupancy in permille (UCI hashfull), sampled from the first 1000 slots
+int tt_hashfull(tt_t *tt);
+// returns true and fills in entry if this hash is present
+bool tt_probe(tt_t *tt, uint64_t hash, tt_entry_t *entry);
+void tt_store(tt_t *tt, uint64_t hash, move_t move, int score, int depth, tt_bound_t bound);
+
+#endif
@@ -1,12 +1,81 @@
 #include <stdio.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include "analyze.h"
+#include "bench.h"
+#include "tt.h"
 #include "uci.h"
 
+static int usage() {
+    fprintf(stderr, "usage: river [input [output]]\n"
+                    "       river bench [depth]\n"
+                    "       river analyze [--depth n] [--nodes n] [--workers n] [--hash mb] [--format csv|jsonl] [--output file] [input]\n");
+    return 1;
+}
+
+// batch analysis of a FEN/EPD file (or stdin), one position per line
+static int analyze_main(int argc, char **argv) {
+    analyze_params_t params = {.depth = -1, .nodes = 0, .workers = 1, .hash_mb = TT_DEFAULT_MB, .format = ANALYZE_CSV};
+    const char *input_name = NULL;
+    const char *output_name = NULL;
+
+    for (int i = 2; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (arg[0] != '-' || !strcmp(arg, "-")) {
+            if (input_name) return usage();
+            input_name = arg;
+            continue;
+        }
+        if (!value) return usage();
+        ++i;
+
+        if (!strcmp(arg, "--depth")) params.depth = atoi(value);
+        else if (!strcmp(arg, "--nodes")) params.nodes = strtoull(value, NULL, 10);
+        else if (!strcmp(arg, "--workers")) params.workers = atoi(value);
+        else if (!strcmp(arg, "--hash")) params.hash_mb = strtoul(value, NULL, 10);
+        else if (!strcmp(arg, "--output")) output_name = value;
+        else if (!strcmp(arg, "--format") && !strcmp(value, "csv")) params.format = ANALYZE_CSV;
+        else if (!strcmp(arg, "--format") && !strcmp(value, "jsonl")) params.format = ANALYZE_JSONL;
+        else return usage();
+    }
+
+    FILE* input = stdin;
+    FILE* output = stdout;
+
+    if (input_name && strcmp(input_name, "-")) {
+        input = fopen(input_name, "r");
+        if (!input) {
+            fprintf(stderr, "failed to open input %s: %s\n", input_name, strerror(errno));
+            return 1;
+        }
+    }
+
+    if (output_name) {
+        output = fopen(output_name, "w");
+        if (!output) {
+            fprintf(stderr, "failed to open output %s: %s\n", output_name, strerror(errno));
+            return 1;
+        }
+    }
+
+    int status = analyze_start(input, output, params);
+
+    fclose(input);
+    fclose(output);
+
+    return status && 1;
+}
+
 int main(int argc, char** argv) {
     FILE* input = stdin;
     FILE* output = stdout;
 
+    if (argc > 1 && !strcmp(argv[1], "analyze")) return analyze_main(argc, argv);
+    if (argc > 1 && !strcmp(argv[1], "bench")) return bench_run(stdout, argc > 2 ? atoi(argv[2]) : BENCH_DEPTH, NULL) && 1;
+
     if (argc > 1) {
         input = fopen(argv[1], "r");
         if (!input) {
@@ -0,0 +1,269 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "attacks.h"
+#include "bench.h"
+#include "bench_util.h"
+#include "engine.h"
+
+// times the engine's hot kernels one at a time over positions taken from the game trees below the bench positions.
+// each kernel is repeated until it ran for at least MIN_TIME_US; hardware counters are shown if perf events are available
+
+#define MAX_POSITIONS (4096)
+#define MAX_SAMPLES (MAX_POSITIONS * 16)
+#define MIN_TIME_US (200000)
+
+typedef struct position {
+    gamestate_t gs;
+    move_t moves[MAX_MOVES];
+    int num_moves;
+} position_t;
+
+static position_t *positions;
+static int num_positions = 0;
+// each bench position contributes an equal share of the positions
+static int collect_limit = 0;
+
+static slider_samples_t samples = {.max = MAX_SAMPLES};
+
+// keeps results alive so the kernels aren't optimised away
+static volatile uint64_t sink;
+
+// positions at every node of a shallow tree below each bench position
+static bool collect(gamestate_t *gs, void *ctx) {
+    (void) ctx;
+    if (num_positions >= collect_limit) return false;
+
+    position_t *pos = &positions[num_positions++];
+    pos->gs = *gs;
+    pos->num_moves = legal_moves(gs, pos->moves);
+    bench_sample_sliders(&samples, &gs->board);
+    return true;
+}
+
+// one pass over the corpus; returns the number of calls made
+static uint64_t kernel_pseudolegal_moves() {
+    move_t moves[MAX_MOVES];
+    uint64_t sum = 0;
+    for (int i = 0; i < num_positions; ++i) sum += pseudolegal_moves(&positions[i].gs, moves);
+    sink += sum;
+    return num_positions;
+}
+
+static uint64_t kernel_legal_moves() {
+    move_t moves[MAX_MOVES];
+    uint64_t sum = 0;
+    for (int i = 0; i < num_positions; ++i) sum += legal_moves(&positions[i].gs, moves);
+    sink += sum;
+    return num_positions;
+}
+
+static uint64_t kernel_rook_attacks() {
+    uint64_t sum = 0;
+    for (int i = 0; i < samples.num_rook; ++i) sum += rook_attacks(samples.rook[i].occ, samples.rook[i].sq);
+    sink += sum;
+    return samples.num_rook;
+}
+
+static uint64_t kernel_bishop_attacks() {
+    uint64_t sum = 0;
+    for (int i = 0; i < samples.num_bishop; ++i) sum += bishop_attacks(samples.bishop[i].occ, samples.bishop[i].sq);
+    sink += sum;
+    return samples.num_bishop;
+}
+
+static uint64_t kernel_is_check() {
+    uint64_t sum = 0;
+    for (int i = 0; i < num_positions; ++i) {
+        const board_t *board = &positions[i].gs.board;
+        int is_b = board->ply & 1;
+        sum += is_check(board, (board->kings >> (is_b * 6)) & 0x3F, is_b);
+    }
+    sink += sum;
+    return num_positions;
+}
+
+// one call is a make_move() and the matching unmake_move()
+static uint64_t kernel_make_unmake() {
+    uint64_t sum = 0, calls = 0;
+    undo_t undo;
+    for (int i = 0; i < num_positions; ++i) {
+        position_t *pos = &positions[i];
+        for (int m = 0; m < pos->num_moves; ++m) {
+            make_move(&pos->gs, pos->moves[m], &undo);
+            sum += pos->gs.hash;
+            unmake_move(&pos->gs, pos->moves[m], &undo);
+        }
+        calls += pos->num_moves;
+    }
+    sink += sum;
+    return calls;
+}
+
+static uint64_t kernel_static_eval() {
+    uint64_t sum = 0;
+    for (int i = 0; i < num_positions; ++i) sum += static_eval(&positions[i].gs);
+    sink += sum;
+    return num_positions;
+}
+
+// one call orders a whole move list (including copying it)
+static uint64_t kernel_order_moves() {
+    move_t moves[MAX_MOVES];
+    uint64_t sum = 0;
+    for (int i = 0; i < num_positions; ++i) {
+        memcpy(moves, positions[i].moves, positions[i].num_moves * sizeof(move_t));
+        order_moves(&positions[i].gs, moves, positions[i].num_moves);
+        sum += move_dst(moves[0]);
+    }
+    sink += sum;
+    return num_positions;
+}
+
+typedef struct kernel {
+    const char *name;
+    uint64_t (*run)();
+} kernel_t;
+
+static const kernel_t kernels[] = {
+    {"pseudolegal_moves", kernel_pseudolegal_moves},
+    {"legal_moves", kernel_legal_moves},
+    {"rook_attacks", kernel_rook_attacks},
+    {"bishop_attacks", kernel_bishop_attacks},
+    {"is_check", kernel_is_check},
+    {"make+unmake_move", kernel_make_unmake},
+    {"static_eval", kernel_static_eval},
+    {"order_moves", kernel_order_moves},
+};
+
+// hardware counters, all read together as one group
+enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_CACHE_MISSES,
+    NB_COUNTERS
+};
+
+typedef struct counters {
+    int fds[NB_COUNTERS];
+    bool enabled;
+} counters_t;
+
+static void counters_open(counters_t *c) {
+    c->enabled = false;
+#ifdef __linux__
+    static const uint64_t configs[NB_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+    };
+
+    for (int i = 0; i < NB_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        c->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : c->fds[0], 0);
+        if (c->fds[i] < 0) {
+            // usually not permitted (perf_event_paranoid) or not supported in a VM
+            for (int j = 0; j < i; ++j) close(c->fds[j]);
+            return;
+        }
+    }
+    c->enabled = true;
+#endif
+}
+
+static void counters_start(counters_t *c) {
+#ifdef __linux__
+    if (!c->enabled) return;
+    ioctl(c->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(c->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static bool counters_stop(counters_t *c, uint64_t *values) {
+#ifdef __linux__
+    if (!c->enabled) return false;
+    ioctl(c->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    uint64_t data[1 + NB_COUNTERS];
+    if (read(c->fds[0], data, sizeof(data)) != sizeof(data) || data[0] != NB_COUNTERS) return false;
+    memcpy(values, &data[1], sizeof(uint64_t) * NB_COUNTERS);
+    return true;
+#else
+    (void) values;
+    return false;
+#endif
+}
+
+static uint64_t run_kernel(void *ctx) {
+    return ((const kernel_t *) ctx)->run();
+}
+
+int main(int argc, char **argv) {
+    // optional filter: only run kernels whose name contains this
+    const char *filter = argc > 1 ? argv[1] : NULL;
+
+    positions = calloc(MAX_POSITIONS, sizeof(position_t));
+    samples.rook = calloc(MAX_SAMPLES, sizeof(slider_sample_t));
+    samples.bishop = calloc(MAX_SAMPLES, sizeof(slider_sample_t));
+    if (!positions || !samples.rook || !samples.bishop) return 1;
+
+    for (int i = 0; i < num_bench_fens; ++i) {
+        gamestate_t gs;
+        if (bench_position(&gs, i)) return 1;
+        collect_limit = (i + 1) * MAX_POSITIONS / num_bench_fens;
+        bench_walk(&gs, 3, collect, NULL);
+    }
+
+    counters_t counters;
+    counters_open(&counters);
+
+    printf("%i positions, %i rook and %i bishop samples (%s slider attacks)%s\n", num_positions, samples.num_rook, samples.num_bishop,
+        attack_backend_names[attacks_selected()], counters.enabled ? "" : "; hardware counters unavailable");
+    printf("%-18s %10s %12s %10s %10s %8s %12s %13s\n", "kernel", "ns/call", "calls/s", "cycles", "instrs", "ipc", "br-miss/1k", "cache-miss/1k");
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        const kernel_t *kernel = &kernels[k];
+        if (filter && !strstr(kernel->name, filter)) continue;
+
+        // warm up caches and branch predictors
+        kernel->run();
+
+        uint64_t calls;
+        uint64_t values[NB_COUNTERS];
+        counters_start(&counters);
+        double elapsed = bench_time(run_kernel, (void *) kernel, MIN_TIME_US, &calls);
+        bool has_counters = counters_stop(&counters, values);
+
+        printf("%-18s %10.2f %12.0f", kernel->name, elapsed / calls, calls * 1e9 / elapsed);
+        if (has_counters) {
+            printf(" %10.1f %10.1f %8.2f %12.2f %13.2f\n", (double) values[COUNTER_CYCLES] / calls, (double) values[COUNTER_INSTRUCTIONS] / calls,
+                values[COUNTER_CYCLES] ? (double) values[COUNTER_INSTRUCTIONS] / values[COUNTER_CYCLES] : 0.0,
+                values[COUNTER_BRANCH_MISSES] * 1000.0 / calls, values[COUNTER_CACHE_MISSES] * 1000.0 / calls);
+        } else {
+            printf(" %10s %10s %8s %12s %13s\n", "-", "-", "-", "-", "-");
+        }
+    }
+
+    free(positions);
+    free(samples.rook);
+    free(samples.bishop);
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "engine.h"
+#include "shared.h"
+#include "timeman.h"
+
+// move generator regression test: perft counts of positions with known results (meson test 'perft')
+
+typedef struct perft_case {
+    const char *name;
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+} perft_case_t;
+
+static const perft_case_t perft_cases[] = {
+    {"startpos", STARTPOS_FEN, 6, 119060324},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+    {"pos3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"pos4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"pos4 mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 5, 15833292},
+    {"pos5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+    {"pos6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+    // en passant: discovered check along the rank, pinned capturer, capture out of check
+    {"ep rank pin", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+    {"ep diagonal pin", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+    {"ep check evasion", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+    // castling: short, long, through attacked squares, and losing the rights
+    {"castle short", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+    {"castle long", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+    {"castle rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+    {"castle attacked", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+    // promotion: underpromotions, promotion with check, discovered check, stalemate
+    {"promote capture", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+    {"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+    {"promote check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+    {"underpromote", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+    {"stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+    {"promote race", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    {"double check", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+int main() {
+    int failures = 0;
+    int num_cases = sizeof(perft_cases) / sizeof(perft_cases[0]);
+
+    for (int i = 0; i < num_cases; ++i) {
+        const perft_case_t *c = &perft_cases[i];
+        gamestate_t gs;
+        memset(&gs, 0, sizeof(gs));
+        const char *fen = c->fen;
+        if (parse_fen(&gs.board, &fen)) {
+            printf("FAIL %-18s invalid fen\n", c->name);
+            ++failures;
+            continue;
+        }
+        gamestate_init(&gs);
+
+        // single threaded without the subtree cache, so every node goes through the generator
+        uint64_t start_us = tm_now_us();
+        uint64_t nodes = perft(&gs, c->depth);
+        uint64_t elapsed_us = tm_now_us() - start_us;
+
+        bool ok = nodes == c->nodes;
+        failures += !ok;
+        printf("%s %-18s depth %i: %10" PRIu64 " (expected %10" PRIu64 ") %8.1f ms %8.0f knps\n", ok ? "ok  " : "FAIL",
+            c->name, c->depth, nodes, c->nodes, elapsed_us / 1000.0, elapsed_us ? nodes * 1000.0 / elapsed_us : 0.0);
+    }
+
+    printf("%i/%i passed\n", num_cases - failures, num_cases);
+    return failures != 0;
+}
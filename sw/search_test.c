@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "engine.h"
+#include "shared.h"
+
+// search regression test: positions with a known forced mate must report it at the right distance (meson test 'search')
+
+typedef struct mate_case {
+    const char *name;
+    const char *fen;
+    int depth;
+    // mate in this many moves, negative if the side to move gets mated
+    int mate;
+} mate_case_t;
+
+static const mate_case_t mate_cases[] = {
+    {"back rank", "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 6, 1},
+    {"rook roller", "7k/8/8/8/8/8/R7/1R4K1 w - - 0 1", 8, 2},
+    {"mated in 3", "7k/r7/1r6/8/8/8/8/6K1 w - - 0 1", 8, -3},
+};
+
+int main() {
+    int failures = 0;
+    int num_cases = sizeof(mate_cases) / sizeof(mate_cases[0]);
+
+    for (int i = 0; i < num_cases; ++i) {
+        const mate_case_t *c = &mate_cases[i];
+        gamestate_t gs;
+        memset(&gs, 0, sizeof(gs));
+        const char *fen = c->fen;
+        if (parse_fen(&gs.board, &fen)) {
+            printf("FAIL %-12s invalid fen\n", c->name);
+            ++failures;
+            continue;
+        }
+        gamestate_init(&gs);
+
+        search_params_t params = {
+            .timeout_ms = -1,
+            .max_depth = c->depth,
+            .threads = 1,
+            .pruning = PRUNE_ALL
+        };
+        best_moves_t moves;
+        int mate = 0;
+        if (!search_moves(&gs, params, &moves) && moves.num_moves > 0) mate = mate_moves(moves.moves[0].eval);
+
+        bool ok = mate == c->mate;
+        failures += !ok;
+        printf("%s %-12s depth %i: mate %i (expected mate %i)\n", ok ? "ok  " : "FAIL", c->name, c->depth, mate, c->mate);
+    }
+
+    printf("%i/%i passed\n", num_cases - failures, num_cases);
+    return failures != 0;
+}
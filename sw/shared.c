@@ -98,10 +98,10 @@ int parse_fen(board_t *board, const char** ptr) {
         do {
             int rights;
             switch (*fen) {
-                case 'k': rights = 0; break;
-                case 'q': rights = 1; break;
-                case 'K': rights = 2; break;
-                case 'Q': rights = 3; break;
+                case 'K': rights = 0; break;
+                case 'Q': rights = 1; break;
+                case 'k': rights = 2; break;
+                case 'q': rights = 3; break;
                 default: return PARSE_FEN_INVALID;
             };
             if (board->castle & (1 << rights)) return PARSE_FEN_INVALID;
@@ -139,44 +139,42 @@ int parse_fen(board_t *board, const char** ptr) {
     return PARSE_FEN_OK;
 }
 
-static move_t invalid_move = {.special = SPECIAL_UNKNOWN};
-
 move_t parse_lan_move(const char** ptr) {
     const char *lan = *ptr;
-    move_t move;
+    move_special_t special;
 
-    if (*lan < 'a' || *lan > 'h') return invalid_move;
-    move.src = (*lan++ - 'a');
-    if (*lan < '1' || *lan > '8') return invalid_move;
-    move.src |= (*lan++ - '1') << 3;
+    if (*lan < 'a' || *lan > 'h') return MOVE_NONE;
+    int src = (*lan++ - 'a');
+    if (*lan < '1' || *lan > '8') return MOVE_NONE;
+    src |= (*lan++ - '1') << 3;
 
-    if (*lan < 'a' || *lan > 'h') return invalid_move;
-    move.dst = (*lan++ - 'a');
-    if (*lan < '1' || *lan > '8') return invalid_move;
-    move.dst |= (*lan++ - '1') << 3;
+    if (*lan < 'a' || *lan > 'h') return MOVE_NONE;
+    int dst = (*lan++ - 'a');
+    if (*lan < '1' || *lan > '8') return MOVE_NONE;
+    dst |= (*lan++ - '1') << 3;
 
     switch (*lan) {
-        case 'n': ++lan; move.special = SPECIAL_PROMOTE_KNIGHT; break;
-        case 'b': ++lan; move.special = SPECIAL_PROMOTE_BISHOP; break;
-        case 'r': ++lan; move.special = SPECIAL_PROMOTE_ROOK; break;
-        case 'q': ++lan; move.special = SPECIAL_PROMOTE_QUEEN; break;
-        default: move.special = SPECIAL_NONE; break;
+        case 'n': ++lan; special = SPECIAL_PROMOTE_KNIGHT; break;
+        case 'b': ++lan; special = SPECIAL_PROMOTE_BISHOP; break;
+        case 'r': ++lan; special = SPECIAL_PROMOTE_ROOK; break;
+        case 'q': ++lan; special = SPECIAL_PROMOTE_QUEEN; break;
+        default: special = SPECIAL_NONE; break;
     }
 
     *ptr = lan;
-    return move;
+    return move_new(src, dst, special);
 }
 
 void serialize_lan_move(const move_t move, char* out) {
-    out[0] = 'a' + (move.src & 7);
-    out[1] = '1' + (move.src >> 3);
-    out[2] = 'a' + (move.dst & 7);
-    out[3] = '1' + (move.dst >> 3);
+    out[0] = 'a' + (move_src(move) & 7);
+    out[1] = '1' + (move_src(move) >> 3);
+    out[2] = 'a' + (move_dst(move) & 7);
+    out[3] = '1' + (move_dst(move) >> 3);
 
     // TODO: extra handling needed for castling/etc.?
-    if (move.special & SPECIAL_PROMOTE) {
+    if (move_special(move) & SPECIAL_PROMOTE) {
         char promo[4] = {[KNIGHT] = 'n', [BISHOP] = 'b', [ROOK] = 'r', [QUEEN] = 'q'};
-        out[4] = promo[move.special & 3];
+        out[4] = promo[move_special(move) & 3];
         out[5] = '\0';
     } else {
         out[4] = '\0';
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bench_util.h"
+#include "engine.h"
+#include "timeman.h"
+#include "tt.h"
+
+// measures lazy SMP scaling: time-to-depth and nodes/sec for increasing thread counts over the bench positions
+
+static const int thread_counts[] = {1, 2, 4, 8, 16};
+
+int main(int argc, char **argv) {
+    int depth = argc > 1 ? atoi(argv[1]) : 5;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 16;
+
+    printf("depth %i\n", depth);
+    printf("%-8s %12s %12s %12s %10s\n", "threads", "time ms", "nodes", "knps", "speedup");
+
+    double base_ms = 0;
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]) && thread_counts[t] <= max_threads; ++t) {
+        search_params_t params = {.timeout_ms = -1, .max_depth = depth, .threads = thread_counts[t], .pruning = PRUNE_ALL};
+        uint64_t nodes = 0;
+        uint64_t total_us = 0;
+
+        for (int i = 0; i < num_bench_fens; ++i) {
+            gamestate_t gs;
+            if (bench_position(&gs, i)) return 1;
+
+            // every run starts from an empty table so thread counts are compared fairly
+            tt_clear(&engine_tt);
+            best_moves_t moves;
+            uint64_t start_us = tm_now_us();
+            if (search_moves(&gs, params, &moves)) return 1;
+            total_us += tm_now_us() - start_us;
+            nodes += moves.stats.nodes;
+        }
+
+        double total_ms = total_us / 1000.0;
+        if (t == 0) base_ms = total_ms;
+        printf("%-8i %12.1f %12lu %12.1f %9.2fx\n", thread_counts[t], total_ms, (unsigned long) nodes,
+            nodes / total_ms, base_ms / total_ms);
+    }
+
+    return 0;
+}
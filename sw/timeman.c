@@ -0,0 +1,69 @@
+#include <time.h>
+
+#include "timeman.h"
+
+// assumed number of moves left when the time control doesn't say
+#define TM_DEFAULT_MOVES_TO_GO (30)
+// a longer horizon than this would only make the search too cautious
+#define TM_MAX_MOVES_TO_GO (80)
+// the hard limit may use up to this many times the soft limit
+#define TM_HARD_SCALE (4)
+// an unstable best move may stretch the soft limit up to this many times, staying clear of the hard limit
+#define TM_UNSTABLE_SCALE (2)
+
+uint64_t tm_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void tm_init(time_manager_t *tm, const search_params_t *params, bool is_b) {
+    tm->start_us = tm_now_us();
+    tm->soft_us = UINT64_MAX;
+    tm->hard_us = UINT64_MAX;
+
+    // a fixed depth search runs to completion regardless of the clock
+    if (params->max_depth >= 0) return;
+
+    if (params->timeout_ms >= 0) {
+        tm->soft_us = tm->hard_us = (uint64_t) params->timeout_ms * 1000;
+        return;
+    }
+
+    int time_left = params->time_left_ms[is_b];
+    if (time_left <= 0) return;
+
+    int increment = params->increment_ms[is_b];
+    int moves_to_go = params->moves_to_go > 0 ? params->moves_to_go : TM_DEFAULT_MOVES_TO_GO;
+    if (moves_to_go > TM_MAX_MOVES_TO_GO) moves_to_go = TM_MAX_MOVES_TO_GO;
+    int usable = time_left - TM_MOVE_OVERHEAD_MS;
+    if (usable < 1) usable = 1;
+
+    int64_t soft_ms = usable / moves_to_go + increment * 3 / 4;
+    int64_t hard_ms = soft_ms * TM_HARD_SCALE;
+    // with a few moves to go, don't save time for moves after the time control
+    if (hard_ms > usable) hard_ms = usable;
+    if (soft_ms > hard_ms) soft_ms = hard_ms;
+
+    tm->soft_us = (uint64_t) soft_ms * 1000;
+    tm->hard_us = (uint64_t) hard_ms * 1000;
+}
+
+uint64_t tm_elapsed_us(const time_manager_t *tm) {
+    return tm_now_us() - tm->start_us;
+}
+
+bool tm_hard_limit(const time_manager_t *tm) {
+    return tm->hard_us != UINT64_MAX && tm_elapsed_us(tm) >= tm->hard_us;
+}
+
+bool tm_soft_limit(const time_manager_t *tm, int instability) {
+    if (tm->soft_us == UINT64_MAX) return false;
+
+    // a best move change (2 points of instability) buys another half of the soft limit, up to TM_UNSTABLE_SCALE times
+    // the soft limit in all
+    uint64_t soft_us = tm->soft_us + tm->soft_us * instability / 4;
+    if (soft_us > tm->soft_us * TM_UNSTABLE_SCALE) soft_us = tm->soft_us * TM_UNSTABLE_SCALE;
+    if (soft_us > tm->hard_us) soft_us = tm->hard_us;
+    return tm_elapsed_us(tm) >= soft_us;
+}
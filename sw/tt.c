@@ -0,0 +1,113 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "tt.h"
+
+uint64_t zobrist_hash(const board_t *board) {
+    uint64_t hash = zobrist_flags(board) ^ ((board->ply & 1) ? zobrist_black : 0);
+
+    for (piece_t p = 0; p < NB_PIECES; ++p) {
+        uint64_t locs = board->pieces[p];
+
+        while (locs != 0) {
+            int sq = __builtin_ctzll(locs);
+            hash ^= zobrist_pieces[((board->pieces_w >> sq) & 1) ^ 1][p][sq];
+            locs &= locs - 1;
+        }
+    }
+
+    hash ^= zobrist_pieces[0][KING][board->kings & 0x3F];
+    hash ^= zobrist_pieces[1][KING][board->kings >> 6];
+
+    return hash;
+}
+
+uint64_t zobrist_pawn_hash(const board_t *board) {
+    uint64_t hash = 0;
+    for (uint64_t locs = board->pieces[PAWN]; locs != 0; locs &= locs - 1) {
+        int sq = __builtin_ctzll(locs);
+        hash ^= zobrist_pieces[((board->pieces_w >> sq) & 1) ^ 1][PAWN][sq];
+    }
+
+    return hash;
+}
+
+tt_t engine_tt = {.slots = NULL, .mask = 0};
+
+int tt_resize(tt_t *tt, size_t size_mb) {
+    if (size_mb < 1) size_mb = 1;
+    if (size_mb > TT_MAX_MB) size_mb = TT_MAX_MB;
+
+    uint64_t num_slots = 1;
+    while (num_slots * 2 * sizeof(tt_slot_t) <= (uint64_t) size_mb << 20) num_slots *= 2;
+
+    tt_slot_t *slots = calloc(num_slots, sizeof(tt_slot_t));
+    if (!slots) return -1;
+
+    free(tt->slots);
+    tt->slots = slots;
+    tt->mask = num_slots - 1;
+    return 0;
+}
+
+void tt_clear(tt_t *tt) {
+    if (tt->slots) memset(tt->slots, 0, (tt->mask + 1) * sizeof(tt_slot_t));
+}
+
+void tt_free(tt_t *tt) {
+    free(tt->slots);
+    tt->slots = NULL;
+    tt->mask = 0;
+}
+
+int tt_hashfull(tt_t *tt) {
+    if (!tt->slots) return 0;
+
+    uint64_t sample = tt->mask + 1 < 1000 ? tt->mask + 1 : 1000;
+    uint64_t used = 0;
+    for (uint64_t i = 0; i < sample; ++i) {
+        used += (atomic_load_explicit(&tt->slots[i].data, memory_order_relaxed) >> 40) != TT_BOUND_NONE;
+    }
+    return (int) (used * 1000 / sample);
+}
+
+static uint64_t tt_pack(move_t move, int score, int depth, tt_bound_t bound) {
+    return (uint64_t) move |
+        ((uint64_t) (uint16_t) score << 16) | ((uint64_t) (uint8_t) depth << 32) | ((uint64_t) bound << 40);
+}
+
+static void tt_unpack(uint64_t data, tt_entry_t *entry) {
+    entry->move = (move_t) data;
+    entry->score = (int16_t) (data >> 16);
+    entry->depth = (int8_t) (data >> 32);
+    entry->bound = (data >> 40) & 0x3;
+}
+
+bool tt_probe(tt_t *tt, uint64_t hash, tt_entry_t *entry) {
+    if (!tt->slots) return false;
+
+    tt_slot_t *slot = &tt->slots[hash & tt->mask];
+    uint64_t key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+    uint64_t data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    if ((key ^ data) != hash || (data >> 40) == TT_BOUND_NONE) return false;
+
+    tt_unpack(data, entry);
+    return true;
+}
+
+void tt_store(tt_t *tt, uint64_t hash, move_t move, int score, int depth, tt_bound_t bound) {
+    if (!tt->slots) return;
+
+    tt_slot_t *slot = &tt->slots[hash & tt->mask];
+    uint64_t old_key = atomic_load_explicit(&slot->key, memory_order_relaxed);
+    uint64_t old_data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+
+    // keep deeper results for the same position unless the new one is exact
+    if ((old_key ^ old_data) == hash && (old_data >> 40) != TT_BOUND_NONE && (int8_t) (old_data >> 32) > depth && bound != TT_BOUND_EXACT) return;
+
+    uint64_t data = tt_pack(move, score, depth, bound);
+    atomic_store_explicit(&slot->key, hash ^ data, memory_order_relaxed);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+}
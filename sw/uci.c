@@ -1,14 +1,153 @@
 #include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <strings.h>
 #include <unistd.h>
 
+#include "bench.h"
 #include "board.h"
 #include "uci.h"
 #include "engine.h"
 #include "shared.h"
+#include "tt.h"
+
+// a search running on its own thread, so the UCI loop can answer isready/stop/ponderhit meanwhile
+typedef struct uci_search {
+    pthread_t thread;
+    // a thread was started and hasn't been joined yet
+    bool running;
+    FILE *out;
+    gamestate_t gs;
+    search_params_t params;
+    // hold the bestmove back until stop, even if the search finishes early
+    bool infinite;
+    atomic_bool stop;
+    atomic_bool ponder;
+    // signalled on stop and ponderhit
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} uci_search_t;
+
+// the reply the engine expects to the best move: the second move of the PV, or else from the transposition table
+static bool ponder_move(const gamestate_t *gamestate, const best_moves_t *best_moves, move_t *reply) {
+    if (best_moves->pv_len > 1) {
+        *reply = best_moves->pv[1];
+        return true;
+    }
+
+    move_t best_move = best_moves->moves[0].move;
+    gamestate_t next = *gamestate;
+    if (execute_move(&next, best_move) < 0) return false;
+
+    tt_entry_t tte;
+    if (!tt_probe(&engine_tt, next.hash, &tte)) return false;
+
+    move_t moves[MAX_MOVES];
+    int num_moves = legal_moves(&next, moves);
+    for (int i = 0; i < num_moves; ++i) {
+        if (moves[i] == tte.move) {
+            *reply = moves[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *search_thread(void *arg) {
+    uci_search_t *search = arg;
+    FILE *out = search->out;
+    best_moves_t moves;
+    int status = search_moves(&search->gs, search->params, &moves);
+
+    // UCI forbids a bestmove during an infinite search or before ponderhit, even if the search is done
+    pthread_mutex_lock(&search->lock);
+    while ((search->infinite || atomic_load(&search->ponder)) && !atomic_load(&search->stop)) {
+        pthread_cond_wait(&search->cond, &search->lock);
+    }
+    pthread_mutex_unlock(&search->lock);
+
+    if (status || moves.num_moves == 0) {
+        fprintf(out, "bestmove 0000\n");
+        fflush(out);
+        return NULL;
+    }
+
+    char move_name[6];
+
+    if (search->gs.engine_debug) {
+        for (int i = 0; i < moves.num_moves; ++i) {
+            serialize_lan_move(moves.moves[i].move, move_name);
+
+            fprintf(out, "info move %3i: %s (eval = %i)\n", i, move_name, moves.moves[i].eval);
+        }
+        fprintf(out, "info string nodes %" PRIu64 " qnodes %" PRIu64 " cutoffs %" PRIu64 " first move cutoffs %" PRIu64 " (%.1f%%) null move cutoffs %" PRIu64 " pawn hash hits %.1f%%\n",
+            moves.stats.nodes, moves.stats.qnodes, moves.stats.cutoffs, moves.stats.first_move_cutoffs,
+            moves.stats.cutoffs ? 100.0 * moves.stats.first_move_cutoffs / moves.stats.cutoffs : 0.0, moves.stats.null_move_cutoffs,
+            moves.stats.pawn_probes ? 100.0 * moves.stats.pawn_hits / moves.stats.pawn_probes : 0.0);
+    }
+
+    serialize_lan_move(moves.moves[0].move, move_name);
+    move_t reply;
+    if (ponder_move(&search->gs, &moves, &reply)) {
+        char reply_name[6];
+        serialize_lan_move(reply, reply_name);
+        fprintf(out, "bestmove %s ponder %s\n", move_name, reply_name);
+    } else {
+        fprintf(out, "bestmove %s\n", move_name);
+    }
+    fflush(out);
+    return NULL;
+}
+
+// stop the running search (if any) and wait for its bestmove
+static void search_finish(uci_search_t *search) {
+    if (!search->running) return;
+
+    pthread_mutex_lock(&search->lock);
+    atomic_store(&search->stop, true);
+    pthread_cond_broadcast(&search->cond);
+    pthread_mutex_unlock(&search->lock);
+
+    pthread_join(search->thread, NULL);
+    search->running = false;
+}
+
+// let a search with limits run to completion (e.g. for scripted use); infinite and ponder searches are stopped
+static void search_wait(uci_search_t *search) {
+    if (!search->running) return;
+    if (search->infinite || atomic_load(&search->ponder)) {
+        search_finish(search);
+        return;
+    }
+
+    pthread_join(search->thread, NULL);
+    search->running = false;
+}
+
+static void search_start(uci_search_t *search, const gamestate_t *gamestate, search_params_t params, bool infinite, bool ponder) {
+    search_wait(search);
+
+    search->gs = *gamestate;
+    search->infinite = infinite;
+    atomic_store(&search->stop, false);
+    atomic_store(&search->ponder, ponder);
+    search->params = params;
+    search->params.stop = &search->stop;
+    search->params.ponder = &search->ponder;
+    search->params.out = search->out;
+
+    search->running = !pthread_create(&search->thread, NULL, search_thread, search);
+    if (!search->running) {
+        // no thread to spare; search synchronously instead
+        atomic_store(&search->ponder, false);
+        search->infinite = false;
+        search_thread(search);
+    }
+}
 
 int uci_start(FILE *in, FILE *out) {
     char *linebuf = NULL;
@@ -17,10 +156,16 @@ int uci_start(FILE *in, FILE *out) {
 
     bool initialized = false;
     bool debug_mode = false;
+    int num_threads = 1;
+    size_t hash_mb = TT_DEFAULT_MB;
+    unsigned pruning = PRUNE_ALL;
     gamestate_t gs;
     const char* init_fen = STARTPOS_FEN;
     assert(!parse_fen(&gs.board, &init_fen));
-    best_moves_t moves;
+    gamestate_init(&gs);
+    uci_search_t search = {.running = false, .out = out};
+    pthread_mutex_init(&search.lock, NULL);
+    pthread_cond_init(&search.cond, NULL);
     const char* uci_delim = " \f\n\r\t\v";
 
     while ((line_len = getline(&linebuf, &line_size, in)) >= 0) {
@@ -31,7 +176,13 @@ int uci_start(FILE *in, FILE *out) {
         if (!strcmp(tok, "uci")) {
             fprintf(out, "id name River_SW\n"
                          "id author Arjun Barrett and Dylan Isaac\n"
-                         "uciok\n");
+                         "option name Hash type spin default %i min 1 max %i\n"
+                         "option name Threads type spin default 1 min 1 max %i\n"
+                         "option name NullMove type check default true\n"
+                         "option name LMR type check default true\n"
+                         "option name ReverseFutility type check default true\n"
+                         "option name Futility type check default true\n"
+                         "uciok\n", TT_DEFAULT_MB, TT_MAX_MB, MAX_THREADS);
             fflush(out);
             initialized = true;
             continue;
@@ -41,6 +192,11 @@ int uci_start(FILE *in, FILE *out) {
             return -1;
         }
 
+        // stop and quit interrupt a running search; anything else (but the commands UCI allows while searching) lets a
+        // search with limits finish first, and only ends infinite and ponder searches early
+        if (!strcmp(tok, "stop") || !strcmp(tok, "quit")) search_finish(&search);
+        else if (strcmp(tok, "isready") && strcmp(tok, "ponderhit") && strcmp(tok, "debug")) search_wait(&search);
+
         if (!strcmp(tok, "debug")) {
             if ((tok = strtok_r(NULL, uci_delim, &sts)) == NULL) continue;
             if (!strcmp(tok, "on")) debug_mode = true;
@@ -48,8 +204,53 @@ int uci_start(FILE *in, FILE *out) {
         } else if (!strcmp(tok, "isready")) {
             fprintf(out, "readyok\n");
             fflush(out);
+        } else if (!strcmp(tok, "setoption")) {
+            // setoption name <id> [value <x>]; ids may contain spaces
+            if ((tok = strtok_r(NULL, uci_delim, &sts)) == NULL || strcmp(tok, "name")) continue;
+            char name[64] = "";
+            char *value = NULL;
+            while ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) {
+                if (!strcmp(tok, "value")) {
+                    value = strtok_r(NULL, uci_delim, &sts);
+                    break;
+                }
+                if (name[0]) strncat(name, " ", sizeof(name) - strlen(name) - 1);
+                strncat(name, tok, sizeof(name) - strlen(name) - 1);
+            }
+
+            if (!strcasecmp(name, "Hash")) {
+                if (value == NULL || tt_resize(&engine_tt, atoi(value))) {
+                    fprintf(out, "info string failed to resize hash\n");
+                    fflush(out);
+                } else {
+                    // perft's subtree cache is allocated per run with the same size
+                    hash_mb = atoi(value);
+                }
+            } else if (!strcasecmp(name, "Threads")) {
+                int threads = value ? atoi(value) : 0;
+                if (threads < 1 || threads > MAX_THREADS) {
+                    fprintf(out, "info string invalid thread count\n");
+                    fflush(out);
+                } else {
+                    num_threads = threads;
+                }
+            } else if (!strcasecmp(name, "NullMove") || !strcasecmp(name, "LMR") ||
+                       !strcasecmp(name, "ReverseFutility") || !strcasecmp(name, "Futility")) {
+                unsigned flag = !strcasecmp(name, "NullMove") ? PRUNE_NULL_MOVE : !strcasecmp(name, "LMR") ? PRUNE_LMR :
+                    !strcasecmp(name, "ReverseFutility") ? PRUNE_REVERSE_FUTILITY : PRUNE_FUTILITY;
+                if (value && !strcmp(value, "true")) pruning |= flag;
+                else if (value && !strcmp(value, "false")) pruning &= ~flag;
+                else {
+                    fprintf(out, "info string invalid value for %s\n", name);
+                    fflush(out);
+                }
+            } else {
+                fprintf(out, "info string unknown option %s\n", name);
+                fflush(out);
+            }
         } else if (!strcmp(tok, "ucinewgame")) {
-            // stateless engine so this isn't necessary to handle
+            // the search itself is stateless, but old hash entries are useless for a new game
+            tt_clear(&engine_tt);
         } else if (!strcmp(tok, "position")) {
             if ((tok = strtok_r(NULL, uci_delim, &sts)) == NULL) continue;
             if (!strcmp(tok, "fen")) {
@@ -61,11 +262,13 @@ int uci_start(FILE *in, FILE *out) {
                 }
                 // TODO: verify
                 gs.board.checkmate = 0;
+                gamestate_init(&gs);
                 tok = strtok_r(fen_loc, uci_delim, &sts);
             } else if (!strcmp(tok, "startpos")) {
                 const char* fen = STARTPOS_FEN;
                 assert(!parse_fen(&gs.board, &fen));
                 gs.board.checkmate = 0;
+                gamestate_init(&gs);
                 tok = strtok_r(NULL, uci_delim, &sts);
             } else {
                 continue;
@@ -75,8 +278,8 @@ int uci_start(FILE *in, FILE *out) {
             if (!strcmp(tok, "moves")) {
                 while ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) {
                     move_t move = parse_lan_move((const char**) &tok);
-                    if (move.special == SPECIAL_UNKNOWN) break;
-                    if (move.special == SPECIAL_NONE) move.special = SPECIAL_UNKNOWN;
+                    if (move == MOVE_NONE) break;
+                    if (move_special(move) == SPECIAL_NONE) move = move_new(move_src(move), move_dst(move), SPECIAL_UNKNOWN);
                     if (execute_move(&gs, move) < 0) {
                         fprintf(out, "info invalid moves\n");
                         continue;
@@ -84,55 +287,103 @@ int uci_start(FILE *in, FILE *out) {
                 }
             }
         } else if (!strcmp(tok, "go")) {
-            search_params_t params = {.timeout_ms = 1000, .max_depth = -1};
+            search_params_t params = {.timeout_ms = 1000, .max_depth = -1, .threads = num_threads, .pruning = pruning};
+            bool infinite = false, ponder = false;
             if ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) {
                 if (!strcmp(tok, "perft")) {
+                    // go perft <n> [divide] [final] [nohash]: counts depths 0 to n - 1
+                    // divide: also print the counts below each root move for the last depth
+                    // final: only count the last depth
+                    // nohash: don't memoise subtree counts
                     int depth = 64;
+                    bool divide = false, final_only = false;
+                    perft_params_t perft_params = {.threads = num_threads, .hash_mb = hash_mb};
                     if ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) depth = atoi(tok);
-                    for (int i = 0; i < depth; ++i) {
-                        uint64_t count = perft(&gs, i);
+                    while ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) {
+                        if (!strcmp(tok, "divide")) divide = true;
+                        else if (!strcmp(tok, "final")) final_only = true;
+                        else if (!strcmp(tok, "nohash")) perft_params.hash_mb = 0;
+                    }
+                    for (int i = final_only ? depth - 1 : 0; i < depth; ++i) {
+                        perft_divide_t counts;
+                        uint64_t count = perft_divide(&gs, i, perft_params, &counts);
+                        if (divide && i == depth - 1) {
+                            for (int m = 0; m < counts.num_moves; ++m) {
+                                char move_name[6];
+                                serialize_lan_move(counts.moves[m], move_name);
+                                fprintf(out, "info perft(%i) %s = %" PRIu64 "\n", i, move_name, counts.counts[m]);
+                            }
+                        }
                         fprintf(out, "info perft(%i) = %" PRIu64 "\n", i, count);
                         fflush(out);
                     }
-                    ;
                     continue;
-                } else if (!strcmp(tok, "depth")) {
-                    if ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) params.max_depth = atoi(tok);
                 } else if (!strcmp(tok, "timeout")) {
                     if ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) params.timeout_ms = atoi(tok);
                 } else {
-                    // standardized UCI commands
+                    // standardized UCI commands; the fixed timeout above only applies if no limit is given
+                    bool has_limit = false;
+                    int movetime = -1;
                     do {
-                        // TODO: implement
-                        break;
+                        if (!strcmp(tok, "infinite")) {
+                            has_limit = true;
+                            infinite = true;
+                            continue;
+                        }
+                        if (!strcmp(tok, "ponder")) {
+                            ponder = true;
+                            continue;
+                        }
+                        if (!strcmp(tok, "depth") || !strcmp(tok, "movetime") || !strcmp(tok, "wtime") || !strcmp(tok, "btime") ||
+                            !strcmp(tok, "winc") || !strcmp(tok, "binc") || !strcmp(tok, "movestogo") || !strcmp(tok, "nodes")) {
+                            char *arg = strtok_r(NULL, uci_delim, &sts);
+                            if (arg == NULL) break;
+                            has_limit = true;
+
+                            if (!strcmp(tok, "depth")) params.max_depth = atoi(arg);
+                            else if (!strcmp(tok, "movetime")) movetime = atoi(arg);
+                            // a flagged clock still gets a sliver of time (0 would mean no clock)
+                            else if (!strcmp(tok, "wtime")) params.time_left_ms[0] = atoi(arg) > 0 ? atoi(arg) : 1;
+                            else if (!strcmp(tok, "btime")) params.time_left_ms[1] = atoi(arg) > 0 ? atoi(arg) : 1;
+                            else if (!strcmp(tok, "winc")) params.increment_ms[0] = atoi(arg);
+                            else if (!strcmp(tok, "binc")) params.increment_ms[1] = atoi(arg);
+                            else if (!strcmp(tok, "movestogo")) params.moves_to_go = atoi(arg);
+                            else if (!strcmp(tok, "nodes")) params.max_nodes = strtoull(arg, NULL, 10);
+                        }
                     } while ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL);
+                    if (has_limit) params.timeout_ms = movetime;
                 }
             }
             gs.engine_debug = debug_mode;
-            if (search_moves(&gs, params, &moves)) continue;
-
-            char move_name[6];
-
-            if (debug_mode) {
-                for (int i = 0; i < moves.num_moves; ++i) {
-                    serialize_lan_move(moves.moves[i].move, move_name);
-
-                    fprintf(out, "info move %3i: %s (eval = %i)\n", i, move_name, moves.moves[i].eval);
-                }
-            }
-
-            serialize_lan_move(moves.moves[0].move, move_name);
-            fprintf(out, "bestmove %s\n", move_name);
-            fflush(stdout);
+            search_start(&search, &gs, params, infinite, ponder);
+        } else if (!strcmp(tok, "ponderhit")) {
+            pthread_mutex_lock(&search.lock);
+            atomic_store(&search.ponder, false);
+            pthread_cond_broadcast(&search.cond);
+            pthread_mutex_unlock(&search.lock);
         } else if (!strcmp(tok, "move")) {
             if ((tok = strtok_r(NULL, uci_delim, &sts)) == NULL) continue;
             move_t move = parse_lan_move((const char**) &tok);
             execute_move(&gs, move);
+        } else if (!strcmp(tok, "bench")) {
+            // bench [depth]: fixed position suite, for comparing speed and node counts between builds
+            int depth = BENCH_DEPTH;
+            if ((tok = strtok_r(NULL, uci_delim, &sts)) != NULL) depth = atoi(tok);
+            if (bench_run(out, depth, NULL)) {
+                fprintf(out, "info bench failed\n");
+                fflush(out);
+            }
+        } else if (!strcmp(tok, "stop")) {
+            // the running search was already stopped above
         } else if (!strcmp(tok, "quit")) {
             initialized = false;
             break;
         }
     }
 
+    if (initialized) search_wait(&search);
+    else search_finish(&search);
+    pthread_mutex_destroy(&search.lock);
+    pthread_cond_destroy(&search.cond);
     return 0;
 }
\ No newline at end of file